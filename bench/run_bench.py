@@ -0,0 +1,119 @@
+import argparse
+import json
+import subprocess
+import sys
+import time
+from glob import glob
+from termcolor import colored
+
+engines = ["ast", "vm"]
+
+
+def read_ops(bench_file):
+    """Number of operations done by a benchmark, from its `-- ops: N` header"""
+    with open(bench_file) as f:
+        for line in f:
+            if line.startswith("-- ops:"):
+                return int(line.split(":")[1])
+    return 0
+
+
+def run_once(binary, engine, bench_file):
+    """Runs a benchmark once, returns its wall time in seconds and the
+    counters printed by --stats=json"""
+    start = time.perf_counter()
+    proc = subprocess.run([binary, f"--engine={engine}", "--stats=json", bench_file],
+                          stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    wall = time.perf_counter() - start
+    if proc.returncode != 0:
+        raise RuntimeError(f"{bench_file} exited with {proc.returncode}")
+    return wall, json.loads(proc.stderr)
+
+
+def run_bench(binary, engine, bench_file, repeat):
+    """Best wall time, allocations and peak RSS of repeat runs. The peak
+    RSS is measured by the interpreter: the ru_maxrss of a child would
+    include the memory of this script, which forked it."""
+    runs = [run_once(binary, engine, bench_file) for _ in range(repeat)]
+    wall = min(run[0] for run in runs)
+    stats = runs[0][1]
+    rss = max(run[1]["peak_rss_kb"] for run in runs)
+    ops = read_ops(bench_file)
+    return {
+        "wall": wall,
+        "ns_per_op": wall * 1e9 / ops if ops else None,
+        "allocs": stats["objects_total"] + stats["sds_allocs"],
+        "rss_kb": rss,
+    }
+
+
+def format_delta(current, baseline, threshold):
+    """Relative change of the wall time, flagged past the threshold"""
+    delta = (current - baseline) / baseline * 100
+    text = f"{delta:+6.1f}%"
+    if delta > threshold:
+        return colored(text + " REGRESSION", "red"), True
+    if delta < -threshold:
+        return colored(text, "green"), False
+    return text, False
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Runs the Carrot benchmarks")
+    parser.add_argument("benchmarks", nargs="*",
+                        help="benchmark files, all the *.cr files by default")
+    parser.add_argument("--binary", default="../carrot.out")
+    parser.add_argument("--engine", choices=engines, action="append",
+                        help="engine to run, both by default")
+    parser.add_argument("--repeat", type=int, default=5,
+                        help="runs per benchmark, the fastest one is kept")
+    parser.add_argument("--save", metavar="FILE",
+                        help="save the results as a baseline")
+    parser.add_argument("--compare", metavar="FILE",
+                        help="compare the results with a saved baseline")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="slowdown in percent reported as a regression")
+    args = parser.parse_args()
+
+    bench_files = args.benchmarks or sorted(glob("*.cr"))
+    baseline = {}
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)
+
+    title = f"Running {len(bench_files)} benchmarks, best of {args.repeat}"
+    print(title)
+    print("=" * len(title))
+    header = f"{'benchmark':<24} {'wall (s)':>9} {'ns/op':>9} {'allocs':>9} {'RSS (KiB)':>10}"
+    if baseline:
+        header += "  vs baseline"
+    print(header)
+
+    results = {}
+    regressions = 0
+    for engine in args.engine or engines:
+        for bench_file in bench_files:
+            name = f"[{engine}] {bench_file}"
+            result = run_bench(args.binary, engine, bench_file, args.repeat)
+            results[name] = result
+
+            ns_per_op = result["ns_per_op"]
+            ns_per_op = f"{ns_per_op:9.1f}" if ns_per_op is not None else f"{'-':>9}"
+            line = (f"{name:<24} {result['wall']:9.3f} {ns_per_op} "
+                    f"{result['allocs']:9} {result['rss_kb']:10}")
+            if name in baseline:
+                delta, regressed = format_delta(result["wall"],
+                                                baseline[name]["wall"],
+                                                args.threshold)
+                regressions += regressed
+                line += f"  {delta}"
+            print(line)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(results, f, indent=4)
+        print(f"\nSaved the results to {args.save}")
+
+    if regressions:
+        print(colored(f"\n{regressions} regression(s) past {args.threshold}%", "red"))
+        sys.exit(1)
@@ -1,71 +1,224 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "include/parser.h"
 #include "include/interpreter.h"
 #include "include/builtin_func.h"
+#include "include/resolver.h"
+#include "include/typecheck.h"
+#include "include/optimizer.h"
+#include "include/compiler.h"
+#include "include/gc.h"
+#include "include/output.h"
+#include "include/profiler.h"
+#include "include/annotate.h"
+#include "include/stats.h"
+#include "include/vm.h"
 #include "lib/include/stb_ds.h"
 
 #define MAX_BUFFER_SIZE 1024
 
-char *read_source_file(char *filename) {
-	char *source;
-	FILE *file = fopen(filename, "r");
-	if (!file) {
+typedef enum {
+	CARROT_ENGINE_AST, CARROT_ENGINE_VM
+} carrot_engine_t;
+
+/* Text of a script, terminated by '\0' */
+typedef struct SOURCE_FILE {
+	char   *text;
+	size_t size;
+	int    mapped;   // text is mapped from the file instead of read
+} SourceFile;
+
+int source_file_open(SourceFile *source, char *filename) {
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0) {
 		printf("Could not open '%s'\n", filename);
-		return NULL;
+		if (fd >= 0) close(fd);
+		return 0;
+	}
+	source->size = st.st_size;
+
+	/* The file is mapped as is when its last page has room left: the
+	 * bytes after the end of the file read as zeros and terminate the
+	 * text. Otherwise it is read into a buffer one byte larger. */
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (source->size % page_size != 0) {
+		source->text = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (source->text != MAP_FAILED) {
+			source->mapped = 1;
+			close(fd);
+			return 1;
+		}
 	}
 
-	// calculate source file size
-	fseek(file, 0, SEEK_END);
-	int size = ftell(file);
-	fseek(file, 0, SEEK_SET);
-
-	source = (char*) calloc(1, sizeof(char) * (size + 1));
-	fread(source, 1, size, file);
-	source[size] = '\0';
-
-	fclose(file);
+	source->mapped = 0;
+	source->text = calloc(1, source->size + 1);
+	size_t n = 0;
+	while (n < source->size) {
+		ssize_t r = read(fd, source->text + n, source->size - n);
+		if (r <= 0) break;
+		n += r;
+	}
+	close(fd);
+	return 1;
+}
 
-	return source;
+void source_file_close(SourceFile *source) {
+	if (source->mapped) {
+		munmap(source->text, source->size);
+	} else {
+		free(source->text);
+	}
+	source->text = NULL;
 }
 
 int main(int argc, char **argv) {
-	char *source;
-	char *filename = argv[1];
+	SourceFile source;
+	char *filename = NULL;
+	carrot_engine_t engine = CARROT_ENGINE_VM;
+	size_t gc_threshold = CARROT_GC_DEFAULT_THRESHOLD;
+	double gc_growth = CARROT_GC_DEFAULT_GROWTH;
+	int opt_level = OPTIMIZER_DEFAULT_LEVEL;
+	int dump_ast = 0;
+	int stats = 0;   // 1 for text, 2 for JSON
+	char *profile = NULL;
+	int annotate = 0;
+	int profile_interval = PROFILER_DEFAULT_INTERVAL;
+	size_t output_size = CARROT_OUTPUT_DEFAULT_SIZE;
+	carrot_flush_t flush_policy = CARROT_FLUSH_DEFAULT;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--engine=ast") == 0) {
+			engine = CARROT_ENGINE_AST;
+		} else if (strcmp(argv[i], "--engine=vm") == 0) {
+			engine = CARROT_ENGINE_VM;
+		} else if (strncmp(argv[i], "--gc-threshold=", 15) == 0) {
+			gc_threshold = strtoull(argv[i] + 15, NULL, 10);
+		} else if (strncmp(argv[i], "--gc-growth=", 12) == 0) {
+			gc_growth = atof(argv[i] + 12);
+			if (gc_growth < 1.0) {
+				printf("The heap growth factor must be at least 1.0\n");
+				exit(1);
+			}
+		} else if (strncmp(argv[i], "--output-buffer=", 16) == 0) {
+			char *end;
+			long long size = strtoll(argv[i] + 16, &end, 10);
+			if (end == argv[i] + 16 || *end != '\0' || size < 0 ||
+			    size > CARROT_OUTPUT_MAX_SIZE) {
+				printf("The output buffer size must be a number of bytes "
+				       "between 0 and %d\n", CARROT_OUTPUT_MAX_SIZE);
+				exit(1);
+			}
+			output_size = size;
+		} else if (strcmp(argv[i], "--flush=line") == 0) {
+			flush_policy = CARROT_FLUSH_LINE;
+		} else if (strcmp(argv[i], "--flush=full") == 0) {
+			flush_policy = CARROT_FLUSH_FULL;
+		} else if (strncmp(argv[i], "-O", 2) == 0 && strlen(argv[i]) == 3 &&
+		           argv[i][2] >= '0' && argv[i][2] <= '0' + OPTIMIZER_MAX_LEVEL) {
+			opt_level = argv[i][2] - '0';
+		} else if (strcmp(argv[i], "--stats") == 0) {
+			stats = 1;
+		} else if (strcmp(argv[i], "--stats=json") == 0) {
+			stats = 2;
+		} else if (strncmp(argv[i], "--profile=", 10) == 0) {
+			profile = argv[i] + 10;
+		} else if (strncmp(argv[i], "--profile-interval=", 19) == 0) {
+			profile_interval = atoi(argv[i] + 19);
+			if (profile_interval <= 0) {
+				printf("The profiling interval must be a positive number of microseconds\n");
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "--annotate") == 0) {
+			annotate = 1;
+		} else if (strcmp(argv[i], "--dump-ast") == 0) {
+			dump_ast = 1;
+		} else if (strncmp(argv[i], "-", 1) == 0) {
+			printf("Unknown option '%s'\n", argv[i]);
+			printf("Usage: carrot [--engine=ast|vm] [-O0|-O1|-O2] [--dump-ast] [--annotate] [--stats[=json]] "
+			       "[--gc-threshold=bytes] [--gc-growth=factor]\n"
+			       "              [--output-buffer=bytes] [--flush=line|full]\n"
+			       "              [--profile=file] [--profile-interval=microseconds] source_file\n");
+			exit(1);
+		} else {
+			filename = argv[i];
+		}
+	}
 
-	if (argc != 2) {
+	if (filename == NULL) {
 		printf("Specify source file");
 		exit(1);
 	}
 
-	source = read_source_file(filename);
-	if (source) {
+	if (source_file_open(&source, filename)) {
 		carrot_init();
+		carrot_gc_configure(gc_threshold, gc_growth);
+		carrot_output_configure(output_size, flush_policy);
 
 		Parser parser;
-		parser_init(&parser, source);
+		parser_init(&parser, source.text);
 		Node *n = parser_parse(&parser);
-		
-		// ..........................
-		// TODO: perform typechecking
-		//...........................
-		//
-		//  carrot_typecheck(&n);
-		//...........................
+		/* the names and literals of the tree are interned, the text
+		 * is only needed to be printed back by --annotate */
+		if (annotate) {
+			int line_cnt = 1;
+			for (char *c = source.text; *c != '\0'; c++) {
+				if (*c == '\n') line_cnt++;
+			}
+			carrot_annotate_start(line_cnt);
+			/* the costs are gathered from the tree nodes */
+			engine = CARROT_ENGINE_AST;
+		} else {
+			source_file_close(&source);
+		}
 
 		Interpreter interpreter = create_interpreter();
+		carrot_gc_push_scope(&interpreter);
 
 		/* register builtin function */
 		carrot_register_all_builtin_func(&interpreter);
 
-		interpreter_interpret(&interpreter, n);
-
+		/* bind variables to slots, builtins included */
+		resolver_resolve(n, &interpreter);
+		carrot_typecheck(n, &interpreter);
+		optimizer_optimize(n, opt_level);
+
+		if (dump_ast) {
+			/* print the tree that would be executed */
+			node_dump(n, 0);
+		} else if (engine == CARROT_ENGINE_VM) {
+			Chunk *chunk = compiler_compile(n);
+			if (profile) carrot_profile_start(profile, profile_interval);
+			vm_interpret(&interpreter, chunk);
+			carrot_profile_stop();
+			chunk_free(chunk);
+		} else {
+			if (profile) carrot_profile_start(profile, profile_interval);
+			interpreter_interpret(&interpreter, n);
+			carrot_profile_stop();
+		}
+		if (stats) {
+			carrot_output_flush();
+			carrot_stats_print(stats == 2);
+		}
+		if (annotate) {
+			carrot_output_flush();
+			carrot_annotate_print(source.text);
+			carrot_annotate_finalize();
+			source_file_close(&source);
+		}
+		carrot_gc_pop_scope();
 		interpreter_free(&interpreter);
+
 		free_node(n);
-		free(source);
 
 		carrot_finalize();
+		carrot_output_finalize();
 
 		return 0;
 	} else {
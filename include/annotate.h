@@ -0,0 +1,21 @@
+#ifndef ANNOTATE_H
+#define ANNOTATE_H
+
+#include "../include/interpreter.h"
+
+/* Per line costs, reported by --annotate. While annotating, every
+ * statement visited by the tree-walking interpreter is charged to its
+ * line:
+ * count    times a statement of the line was executed
+ * time     time spent in them, nested statements and calls included
+ *          (a recursive call is not counted twice)
+ * objects  CarrotObj's allocated by the line itself, the ones of the
+ *          nested statements are charged to their own lines */
+extern int CARROT_ANNOTATING;
+
+void carrot_annotate_start(int line_cnt);
+CarrotValue carrot_annotate_visit(Interpreter *context, Node *stmt);
+void carrot_annotate_print(char *source);
+void carrot_annotate_finalize();
+
+#endif
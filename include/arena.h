@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Memory is carved out of large blocks and only given back all at once
+ * by arena_free(). Allocations larger than a block get a block of their
+ * own. */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ARENA_BLOCK {
+	struct ARENA_BLOCK *next;
+	size_t             size;
+	size_t             used;
+	char               data[];
+} ArenaBlock;
+
+typedef struct ARENA {
+	ArenaBlock *blocks;   // the block being filled comes first
+	size_t     allocated; // bytes requested from malloc, blocks included
+} Arena;
+
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *s);
+void arena_free(Arena *arena);
+
+#endif
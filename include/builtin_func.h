@@ -1,6 +1,11 @@
 #ifndef BUILTIN_FUNC_H
 #define BUILTIN_FUNC_H
 
+#include "../include/interpreter.h"
+
 void carrot_register_all_builtin_func(Interpreter *interpreter);
+data_type_t carrot_builtin_ret_type(CarrotObj *builtin);
+void carrot_range_args(CarrotValue *args, int argc, int *start, int *stop, int *step);
+int carrot_is_range_func(CarrotValue value);
 
 #endif
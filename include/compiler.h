@@ -0,0 +1,73 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdint.h>
+#include "../include/parser.h"
+#include "../include/interpreter.h"
+
+/* Operands wider than one byte are encoded big-endian on two bytes */
+#define MAX_CHUNK_OPERAND 65535
+
+typedef enum {
+	/* Values and variables */
+	OP_CONST,         // [idx16]            push constants[idx]
+	OP_POP,
+	OP_GET_LOCAL,     // [depth8][slot16][name16]
+	OP_GET_GLOBAL,    // [slot16][name16]
+	OP_GET_VAR,       // [name16]           unresolved, looked up by name
+	OP_SET_LOCAL,     // [slot16]           leaves the value on the stack
+	OP_DEF_LOCAL,     // [slot16][name16]   consumes the value
+	OP_DEF_FUNC,      // [idx16][slot16]    binds constants[idx]
+
+	/* Operators */
+	OP_BINARY,        // [operator8]        see operator_t
+	OP_BINARY_INT,    // [operator8]        both operands known to be ints
+	OP_BINARY_FLOAT,  // [operator8]        both operands known to be floats
+	OP_NOT, OP_NEGATE,
+
+	/* Lists */
+	OP_BUILD_LIST,    // [count16]
+	OP_GET_ITEM,
+
+	/* Control flow */
+	OP_JUMP,          // [offset16]         forward
+	OP_JUMP_IF_FALSE, // [offset16]         forward, pops the condition
+	OP_CALL,          // [argc8]
+	OP_RETURN,
+
+	/* iter loops */
+	OP_ITER_BEGIN,    // [layout16]         opens the loop scope, the iterable
+	                  //                    stays on the stack
+	OP_ITER_RANGE,    // [argc8][layout16][offset16]
+	                  //                    same for range(...) without
+	                  //                    calling it, if the callee is
+	                  //                    the builtin range
+	OP_ITER_NEXT,     // [slot16][index_slot16][loop_offset16]
+	                  //                    binds the next item and jumps
+	                  //                    back, or falls through
+	OP_ITER_END,      // closes the loop scope and pops the iterable
+} opcode_t;
+
+/* Marks the absence of an optional slot operand, e.g. the index
+ * variable of an iter loop without "@ idx" */
+#define CHUNK_NO_SLOT MAX_CHUNK_OPERAND
+
+typedef struct CHUNK {
+	char      *name;      // function name, "<script>" for the script
+	uint8_t   *code;      // stb_ds array
+	int       *lines;     // stb_ds array, source line of each byte of code
+	int       line;       // line of the code being compiled
+	CarrotValue *constants; // stb_ds array
+	/* Variable names referenced by the code. They point into the
+	 * Node tree, so a chunk must not outlive the nodes it was
+	 * compiled from */
+	char      **names;     // stb_ds array
+	/* Slot layouts of the iter loops, owned by the nodes as well */
+	ScopeLayout **layouts; // stb_ds array
+} Chunk;
+
+/* node must have gone through resolver_resolve() */
+Chunk *compiler_compile(Node *node);
+void chunk_free(Chunk *chunk);
+
+#endif
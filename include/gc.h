@@ -0,0 +1,44 @@
+#ifndef GC_H
+#define GC_H
+
+#include <stddef.h>
+#include "../include/interpreter.h"
+
+/* A collection is requested once the heap grows past the threshold.
+ * After each collection the threshold becomes the live heap size
+ * times the growth factor (but never less than the initial one). */
+#define CARROT_GC_DEFAULT_THRESHOLD (1024 * 1024)
+#define CARROT_GC_DEFAULT_GROWTH    2.0
+
+typedef void (*carrot_gc_marker_t)(void *data);
+
+typedef struct GC_MARKER {
+	carrot_gc_marker_t marker;
+	void               *data;
+} GCMarker;
+
+extern int CARROT_GC_REQUESTED;
+
+/* Collections only happen at safe points, where every live value is
+ * reachable from a registered scope, a temporary root or a marker.
+ * Allocating never collects by itself. */
+#define carrot_gc_safepoint() \
+	do { if (CARROT_GC_REQUESTED) carrot_gc_collect(); } while (0)
+
+void carrot_gc_configure(size_t threshold, double growth);
+void carrot_gc_account(size_t size);
+void carrot_gc_release(CarrotObj *obj);
+void carrot_gc_collect();
+void carrot_gc_finalize();
+
+void carrot_gc_mark_value(CarrotValue value);
+void carrot_gc_mark_scope(Interpreter *scope);
+
+void carrot_gc_push_scope(Interpreter *scope);
+void carrot_gc_pop_scope();
+void carrot_gc_push_root(CarrotValue value);
+void carrot_gc_pop_roots(int n);
+void carrot_gc_add_marker(carrot_gc_marker_t marker, void *data);
+void carrot_gc_remove_marker(carrot_gc_marker_t marker, void *data);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+/* Every identifier and string literal of the scripts is stored once in
+ * the intern table. Equal strings get the same address, so the tables
+ * keyed by names (scopes, scope layouts) hash and compare the address
+ * only. Interned strings live until carrot_intern_finalize(). */
+char *carrot_intern(const char *s);
+char *carrot_intern_len(const char *s, int len);
+void carrot_intern_finalize();
+
+#endif
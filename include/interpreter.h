@@ -7,110 +7,251 @@
 typedef enum {
 	CARROT_STR, CARROT_INT, CARROT_FLOAT, CARROT_BOOL, CARROT_LIST,
 	CARROT_NULL, CARROT_FUNCTION,
+	/* A list whose items are computed on demand, made by range(). For
+	 * the scripts it is a list. */
+	CARROT_RANGE,
+	/* Content of a variable slot whose variable is not bound yet. It
+	 * never reaches a script. */
+	CARROT_UNDEFINED,
 } carrot_dtype_t;
 
+#define CARROT_DTYPE_NUM (CARROT_UNDEFINED + 1)
+
+/* Strings, lists, ranges and functions live in the heap as CarrotObj's.
+ * The other types are immediate: they are stored directly inside the
+ * CarrotValue and never allocate. */
+#define carrot_is_heap_type(type) ((type) == CARROT_STR      || \
+                                   (type) == CARROT_LIST     || \
+                                   (type) == CARROT_FUNCTION || \
+                                   (type) == CARROT_RANGE)
+
+typedef struct CarrotValue_t {
+	carrot_dtype_t          type;
+	union {
+		int                 int_val;
+		int                 bool_val;
+		float               float_val;
+		struct CarrotObj_t  *obj;      // heap types only
+	};
+} CarrotValue;
+
+/* State of an iteration over any iterable value, see carrot_iter_next() */
+typedef struct CARROT_ITERATOR {
+	CarrotValue         iterable;
+	int                 idx;              // number of items produced so far
+} CarrotIterator;
+
+/* Properties shared by every value of a type, see CARROT_TYPES */
+typedef struct CARROT_TYPE {
+	char                *name;
+	/* Iterator protocol: stores the next item of iter in item and
+	 * returns 1, or returns 0 once there are no items left. NULL if the
+	 * values of the type are not iterable. */
+	int                 (*iter_next)(CarrotIterator *iter, CarrotValue *item);
+} CarrotType;
+
+typedef CarrotValue (*carrot_binop_t)(CarrotValue left, CarrotValue right);
+
 typedef struct CarrotObj_t {
 	carrot_dtype_t      type;
-	sds                 type_str;
-
-	struct CarrotObj_t  **list_items;
-
-	/* Value properties */
-	struct CarrotObj_t  *self;
-	int                 bool_val;
-	int                 int_val;
-	float               float_val;
-	sds                 str_val;
-
-	/* Function call object properties */
-	struct CarrotObj_t  *(*builtin_func)(struct CarrotObj_t **args);
-	int                 is_builtin;
-	char                func_name[255];   // shared with function def object
-	char                **func_arg_names; // shared with function def object
-
-	/* Function definition object properties 
-	 * No need to free this inside interpreter_free() */
-	Node                **func_statements;
-
-	/* Common properties */
-	sds                 repr;
-	char	            *hash;
-
-	/* Object builtin methods */
-	struct CarrotObj_t  **members;
-	struct CarrotObj_t  *(*__plus)(struct CarrotObj_t *self);
-	struct CarrotObj_t  *(*__negate)(struct CarrotObj_t *self);
-	struct CarrotObj_t  *(*__not)(struct CarrotObj_t *self);
-	struct CarrotObj_t  *(*__add)(struct CarrotObj_t *self, 
-			              struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__subtract)(struct CarrotObj_t *self,
-	                                   struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__mult)(struct CarrotObj_t *self,
-	                               struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__div)(struct CarrotObj_t *self,
-	                              struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__ee)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__ne)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__ge)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__le)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__gt)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__lt)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__and)(struct CarrotObj_t *self,
-	                              struct CarrotObj_t *other);
-	struct CarrotObj_t  *(*__or)(struct CarrotObj_t *self,
-	                             struct CarrotObj_t *other);
+	int                 marked;           // garbage collector mark bit
+	int                 refcount;         // see carrot_incref()
+	/* Links of CARROT_HEAP_OBJS */
+	struct CarrotObj_t  *prev;
+	struct CarrotObj_t  *next;
+
+	union {
+		/* CARROT_STR */
+		sds             str_val;
+
+		/* CARROT_LIST and CARROT_RANGE */
+		struct {
+			union {
+				CarrotValue *list_items;
+
+				/* CARROT_RANGE, from range_start up to
+				 * range_stop (excluded) */
+				struct {
+					int range_start;
+					int range_stop;
+					int range_step;   // never 0
+				};
+			};
+			sds         repr;             // built lazily, see carrot_obj_repr()
+		};
+
+		/* CARROT_FUNCTION. The name and the definition belong to the
+		 * function def node, no need to free them in carrot_free() */
+		struct {
+			CarrotValue (*builtin_func)(CarrotValue *args); // NULL if user defined
+			char        *func_name;
+			Node        *func_def;        // NULL if builtin
+			struct CHUNK *func_chunk;     // compiled body, used by the VM
+		};
+	};
 } CarrotObj;
 
 
+/* stb_ds hashmap keyed by interned names */
 typedef struct SymTable_t {
 	char *key;
-	CarrotObj *value;
+	CarrotValue value;
 } SymTable;
 
+/* Heap objects keyed by interned names */
+typedef struct ObjTable_t {
+	char *key;
+	CarrotObj *value;
+} ObjTable;
+
+/* A scope stores the variables known to the resolver in slots laid out
+ * by its ScopeLayout. The sym_table only holds the variables bound by
+ * unresolved code, e.g. coming from carrot_eval(). */
 typedef struct INTERPRETER {
-	SymTable *sym_table;
+	SymTable           *sym_table;
 	struct INTERPRETER *parent;
+	struct INTERPRETER *globals;
+	ScopeLayout        *layout;   // NULL if the scope has no slots
+	CarrotValue        *slots;    // owned by the global scope only
 } Interpreter;
 
+/* Every live heap object, the most recent first */
+extern CarrotObj *CARROT_HEAP_OBJS;
+extern const CarrotType CARROT_TYPES[];
+
+/* Binary operator handlers indexed by the left operand type, the right
+ * operand type and the operator. NULL if the operation is undefined. */
+extern const carrot_binop_t CARROT_BINOPS[CARROT_DTYPE_NUM][CARROT_DTYPE_NUM][BINARY_OPR_NUM];
 
 Interpreter create_interpreter();
+void interpreter_open_scope(Interpreter *scope,
+		            Interpreter *parent,
+		            ScopeLayout *layout,
+		            CarrotValue *slots);
+void interpreter_use_layout(Interpreter *globals, ScopeLayout *layout);
+
+CarrotValue interpreter_init(Interpreter *interpreter, Node *node);
+CarrotValue interpreter_interpret(Interpreter *interpreter, Node *node);
+CarrotValue interpreter_visit(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_binop(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_block(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_func_call(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_func_def(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_get_item(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_if(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_iter(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_list(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_return(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_statements(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_unop(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_value(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_var_access(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_var_assign(Interpreter *context, Node *node);
+CarrotValue interpreter_visit_var_def(Interpreter *context, Node *node);
+
+CarrotObj *carrot_obj_allocate(carrot_dtype_t type);
+CarrotValue carrot_obj_value(CarrotObj *obj);
+CarrotValue carrot_noop();
+CarrotValue carrot_null();
+CarrotValue *carrot_get_var(char *var_name, Interpreter *context);
+CarrotValue *carrot_get_local_var(char *var_name, Interpreter *context);
+CarrotValue carrot_lookup_var(char *var_name, Interpreter *context);
+void carrot_set_var(char *var_name, Interpreter *context, CarrotValue value);
+CarrotValue carrot_undefined();
+CarrotValue carrot_bool(int bool_val);
+CarrotValue carrot_int(int int_val);
+CarrotValue carrot_list(CarrotValue *list_items);
+CarrotValue carrot_range(int start, int stop, int step);
+CarrotValue carrot_float(float float_val);
+CarrotValue carrot_str(char *str_val);
+CarrotValue carrot_str_const(char *str_val);
+
+/* Reference counting. The slots, symbol tables, list items, chunk
+ * constants and VM stack entries holding a heap value each own a
+ * reference to it, as does the caller of interpreter_visit() and of the
+ * value constructors. An object is released once its last reference is
+ * dropped. The references that are never dropped, e.g. those of values
+ * reachable from a cycle or owned by a chunk, are left to the garbage
+ * collector. */
+void carrot_release(CarrotObj *obj);
+
+static inline CarrotValue carrot_incref(CarrotValue value) {
+	if (carrot_is_heap_type(value.type)) value.obj->refcount++;
+	return value;
+}
+
+static inline void carrot_decref(CarrotValue value) {
+	if (carrot_is_heap_type(value.type) && --value.obj->refcount == 0)
+		carrot_release(value.obj);
+}
+
+static inline void carrot_assign(CarrotValue *slot, CarrotValue value) {
+	/* Stores value in slot, which takes over its reference, and drops
+	 * the reference of the value it replaces */
+	CarrotValue old = *slot;
+	*slot = value;
+	carrot_decref(old);
+}
+
+void carrot_binop_error(operator_t op, CarrotValue left, CarrotValue right);
+CarrotValue carrot_unop(operator_t op, CarrotValue right);
+
+static inline CarrotValue carrot_binop(operator_t op, CarrotValue left, CarrotValue right) {
+	carrot_binop_t handler = CARROT_BINOPS[left.type][right.type][op];
+	if (handler == NULL) carrot_binop_error(op, left, right);
+	return handler(left, right);
+}
+
+/* Operators on two ints or two floats, for the binary operator nodes whose
+ * operand_type is known. Same results as the handlers of CARROT_BINOPS. */
+static inline CarrotValue carrot_int_binop(operator_t op, int left, int right) {
+	switch (op) {
+		case OPR_ADD:      return (CarrotValue) {CARROT_INT, {.int_val = left + right}};
+		case OPR_SUBTRACT: return (CarrotValue) {CARROT_INT, {.int_val = left - right}};
+		case OPR_MULT:     return (CarrotValue) {CARROT_INT, {.int_val = left * right}};
+		case OPR_DIV:      return (CarrotValue) {CARROT_INT, {.int_val = left / right}};
+		case OPR_EE:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left == right}};
+		case OPR_NE:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left != right}};
+		case OPR_GT:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left > right}};
+		case OPR_LT:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left < right}};
+		case OPR_GE:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left >= right}};
+		default:           return (CarrotValue) {CARROT_BOOL, {.bool_val = left <= right}};
+	}
+}
+
+static inline CarrotValue carrot_float_binop(operator_t op, float left, float right) {
+	switch (op) {
+		case OPR_ADD:      return (CarrotValue) {CARROT_FLOAT, {.float_val = left + right}};
+		case OPR_SUBTRACT: return (CarrotValue) {CARROT_FLOAT, {.float_val = left - right}};
+		case OPR_MULT:     return (CarrotValue) {CARROT_FLOAT, {.float_val = left * right}};
+		case OPR_DIV:      return (CarrotValue) {CARROT_FLOAT, {.float_val = left / right}};
+		case OPR_EE:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left == right}};
+		case OPR_NE:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left != right}};
+		case OPR_GT:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left > right}};
+		case OPR_LT:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left < right}};
+		case OPR_GE:       return (CarrotValue) {CARROT_BOOL, {.bool_val = left >= right}};
+		default:           return (CarrotValue) {CARROT_BOOL, {.bool_val = left <= right}};
+	}
+}
+
+void carrot_check_arg(CarrotObj *function, int i, CarrotValue arg);
+
+void carrot_iter_init(CarrotIterator *iter, CarrotValue iterable);
+int carrot_range_len(CarrotObj *range);
+int carrot_range_count(int start, int stop, int step);
+CarrotValue carrot_get_item(CarrotValue the_list, CarrotValue the_index);
+
+static inline int carrot_iter_next(CarrotIterator *iter, CarrotValue *item) {
+	return CARROT_TYPES[iter->iterable.type].iter_next(iter, item);
+}
+
+int carrot_is_true(CarrotValue value);
+char *carrot_obj_repr(CarrotObj *obj);
+size_t carrot_obj_size(CarrotObj *obj);
+sds carrot_repr_cat(sds s, CarrotValue value);
+char *carrot_type_str(CarrotValue value);
 
-CarrotObj *interpreter_init(Interpreter *interpreter, Node *node);
-CarrotObj *interpreter_interpret(Interpreter *interpreter, Node *node);
-CarrotObj *interpreter_visit(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_binop(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_block(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_func_call(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_func_def(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_get_item(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_if(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_iter(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_list(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_return(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_statements(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_unop(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_value(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_var_access(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_var_assign(Interpreter *context, Node *node);
-CarrotObj *interpreter_visit_var_def(Interpreter *context, Node *node);
-
-CarrotObj *carrot_obj_allocate();
-CarrotObj *carrot_noop();
-CarrotObj *carrot_null();
-CarrotObj *carrot_get_var(char *var_name, Interpreter *context);
-CarrotObj *carrot_bool(int bool_val);
-CarrotObj *carrot_int(int int_val);
-CarrotObj *carrot_list(CarrotObj **list_items);
-CarrotObj *carrot_float(float float_val);
-CarrotObj *carrot_str(char *str_val);
-
-CarrotObj *carrot_eval(Interpreter *interpreter, char *source);
+CarrotValue carrot_eval(Interpreter *interpreter, char *source);
 
 void carrot_finalize();
 void carrot_free(CarrotObj *root);
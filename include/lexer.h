@@ -1,14 +1,19 @@
 #ifndef LEXER_H
 #define LEXER_H
 
-#define MAX_TOKEN_NUM 4096
-#define MAX_TOKEN_TEXT_LEN 128
+
+/* Tokens are produced on demand. The ring buffer holds the tokens that
+ * were scanned ahead but not consumed yet, it must be a power of 2. */
+#define LEXER_LOOKAHEAD 4
 
 typedef enum {
 	/* Primitive literal */
 	T_INT, T_FLOAT, T_STR,
-	/* Identifier and keyword */
-	T_ID, T_KEYWORD,
+	/* Identifier */
+	T_ID,
+	/* Keywords, see tok_is_keyword() */
+	T_AS, T_ELIF, T_ELSE, T_END, T_FALSE, T_FUNC, T_IF, T_ITER,
+	T_RETURN, T_TRUE, T_VAR,
 	/* Arithmetic */
 	T_PLUS, T_MINUS, T_MULT, T_DIV,
 	/* Logical */
@@ -24,9 +29,17 @@ typedef enum {
 	T_COMMA, T_EOF, T_UNKNOWN, T_AT
 } tok_kind_t;
 
+#define tok_is_keyword(kind) ((kind) >= T_AS && (kind) <= T_VAR)
+
+/* The text of a token is not copied, it is the span of the source that
+ * starts at start. The span of a string literal is inside the quotes and
+ * keeps the escapes, see lexer_token_str(). */
 typedef struct TOKEN {
 	tok_kind_t tok_kind;
-	char       text[MAX_TOKEN_TEXT_LEN];
+	int        start;
+	int        len;
+	char       *name;     // interned text of identifiers and keywords,
+	                      // NULL for the other tokens
 
 	/* Token coordinate information */
 	int        line_num;
@@ -38,19 +51,20 @@ typedef struct LEXER {
 	int   idx;
 	int   line_num;
 	char  *source;
-	int   token_cnt;
-	Token tokens[MAX_TOKEN_NUM];
+	Token lookahead[LEXER_LOOKAHEAD];
+	int   lookahead_start;   // oldest token in lookahead
+	int   lookahead_cnt;
 } Lexer;
 
-int is_keyword(char *s);
+tok_kind_t keyword_kind(char *s, int len);
 int is_escape(char* s);
 char *tok_kind_to_str(tok_kind_t kind);
 
-Token create_token(tok_kind_t tok_kind, char *text);
+Token create_token(tok_kind_t tok_kind, int start, int len);
 void make_identifier(Lexer *lexer);
 void make_number(Lexer *lexer);
-void make_single_char_token(Lexer *lexer, tok_kind_t kind, char *text);
-void make_two_chars_token(Lexer *lexer, tok_kind_t kind, char *text);
+void make_single_char_token(Lexer *lexer, tok_kind_t kind);
+void make_two_chars_token(Lexer *lexer, tok_kind_t kind);
 void make_string(Lexer *lexer);
 
 void lexer_add_token(Lexer *lexer, Token t);
@@ -60,5 +74,8 @@ void lexer_skip_comment(Lexer *lexer);
 void lexer_skip_whitespace(Lexer *lexer);
 
 void lexer_lex(Lexer *lexer);
+Token lexer_next_token(Lexer *lexer);
+Token lexer_peek_token(Lexer *lexer, int n);
+char *lexer_token_str(Lexer *lexer, Token t);
 
 #endif
@@ -0,0 +1,18 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "../include/parser.h"
+
+/* Optimization levels, selected with -O0, -O1 and -O2:
+ * 0  the tree is executed as parsed
+ * 1  operators whose operands are literals are folded into literals
+ * 2  level 1, and the branches of if statements that are decided by a
+ *    literal condition are resolved before execution */
+#define OPTIMIZER_MAX_LEVEL     2
+#define OPTIMIZER_DEFAULT_LEVEL 1
+
+/* Rewrites the tree of a type checked script in place. The nodes keep
+ * their resolution, so the script does not need to be resolved again. */
+void optimizer_optimize(Node *script, int level);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include "../include/interpreter.h"
+
+/* The output of the scripts is gathered in a buffer owned by the
+ * interpreter and written to the standard output in large chunks. When
+ * the buffer is written out depends on the flush policy:
+ * line  after every write that contains a newline
+ * full  only once the buffer is full
+ * With either policy the buffer is written out by the flush() builtin
+ * and when the interpreter exits, errors included. By default the
+ * policy is line on a terminal and full otherwise. */
+#define CARROT_OUTPUT_DEFAULT_SIZE (64 * 1024)
+#define CARROT_OUTPUT_MAX_SIZE     (256 * 1024 * 1024)
+
+typedef enum {
+	CARROT_FLUSH_DEFAULT, CARROT_FLUSH_LINE, CARROT_FLUSH_FULL
+} carrot_flush_t;
+
+void carrot_output_configure(size_t size, carrot_flush_t policy);
+void carrot_output_write(const char *s, size_t len);
+void carrot_output_str(const char *s);
+void carrot_output_value(CarrotValue value);
+void carrot_output_flush();
+void carrot_output_finalize();
+
+#endif
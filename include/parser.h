@@ -1,14 +1,9 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "../include/arena.h"
 #include "../include/lexer.h"
 
-#define MAX_NODE_NUM        2048
-#define MAX_STR_LITERAL_LEN 512
-#define MAX_STATEMENT_NUM   2048
-#define MAX_VAR_NAME_LEN    255
-#define MAX_VAR_TYPE_LEN    255
-
 typedef struct Node_t Node;
 
 typedef enum {
@@ -17,6 +12,7 @@ typedef enum {
 	N_UNOP,
 	N_FUNC_DEF,
 	N_FUNC_CALL,
+	N_FUNC_PARAM,
 	N_GET_ITEM,
 	N_IF,
 	N_ITER,
@@ -31,90 +27,170 @@ typedef enum {
 	N_VAR_ACCESS,
 } node_type_t;
 
+/* Binary operators come first since they index the operator dispatch
+ * matrix of the runtime, see CARROT_BINOPS */
 typedef enum {
-	DT_STR, DT_INT, DT_FLOAT, DT_BOOL, DT_LIST, DT_NULL, DT_UNKNOWN
-} data_type_t;
+	OPR_ADD, OPR_SUBTRACT, OPR_MULT, OPR_DIV,
+	OPR_EE, OPR_NE, OPR_GT, OPR_LT, OPR_GE, OPR_LE,
+	OPR_AND, OPR_OR,
+	/* Unary */
+	OPR_NOT, OPR_NEGATE, OPR_PLUS,
+	OPR_UNKNOWN
+} operator_t;
+
+#define BINARY_OPR_NUM (OPR_OR + 1)
 
+typedef enum {
+	DT_STR, DT_INT, DT_FLOAT, DT_BOOL, DT_LIST, DT_NULL, DT_FUNC,
+	DT_UNKNOWN   // not known before execution
+} data_type_t;
 
-typedef struct Symtable_t {
-	char          *key;
-	struct Node_t *value;
-} Symtable;
 
+/* How a variable reference is found at runtime, filled in by the
+ * resolver. Unresolved references are looked up by name. */
+typedef enum {
+	RES_DYNAMIC,  // by name through the scope chain
+	RES_LOCAL,    // var_slot of the scope var_depth levels up
+	RES_GLOBAL,   // var_slot of the global scope
+} resolution_t;
+
+typedef struct SlotTable_t {
+	char *key;
+	int  value;
+} SlotTable;
+
+/* The variables bound directly in a scope (the script, a function body
+ * or an iter body) and the slot each one is stored in */
+typedef struct SCOPE_LAYOUT {
+	SlotTable *slots; // stb_ds hashmap keyed by interned names
+} ScopeLayout;
+
+#define scope_layout_size(layout) ((layout) == NULL ? 0 : hmlen((layout)->slots))
+
+/* A fixed list of child nodes, allocated in the arena of the script */
+typedef struct NODE_LIST {
+	struct Node_t      **items;
+	int                len;
+} NodeList;
+
+/* Each node kind only carries its own fields. Nodes and node lists live
+ * in the arena owned by the script node, see free_node(). Names and
+ * string literals are interned, see carrot_intern(). */
 typedef struct Node_t {
 	node_type_t        type;
-
-	/* value node */
-	int                int_val;
-	float              float_val;
-	char               str_val[MAX_STR_LITERAL_LEN];
-	int                bool_val;
-	struct Node_t      *obj_val;
-	Token              value_token; // shared with variable definition node
-	struct Node_t      **list_items; // if a list. TODO: more consistent naming
-
-	/* binary operation node */
-	struct Node_t      *left;
-	struct Node_t      *right;
-	char               op_str[3]; // assuming longest op string of 3
-
-	/* statements node */
-	struct Node_t      **statements;
-
-	/* code block node */
-	struct Node_t      **block_statements;
-
-	/* variable definition node */
-	char               var_name[MAX_VAR_NAME_LEN];
-	data_type_t        var_type;
-	char               var_type_str[MAX_VAR_TYPE_LEN];
-	struct Node_t      *var_node;
-
-	/* function definition node */
-	char               func_name[MAX_VAR_NAME_LEN];
-	int                is_builtin;
-	struct Node_t      **func_params;
-	struct Node_t      **func_statements;
-
-	/* item access node */
-	struct Node_t      *list_node;
-	struct Node_t      *index_node;
-
-	/* if node */
-	struct Node_t      **conditions;
-	//                 The if_blocks[i] will be executed if
-	//                 conditions[i] is true
-	struct Node_t      **if_blocks;   
-	//                 if none of conditions is true then else_block
-	//                 will be executed
-	struct Node_t      *else_block;
-
-	/* loop node */
-	struct Node_t      *iterable;
-	struct Node_t      **loop_statements;
-	char               loop_index_var_name[MAX_VAR_NAME_LEN];
-	char               loop_iterator_var_name[MAX_VAR_NAME_LEN];
-	int                loop_with_index;
-
-	/* function param node */
-	char               param_name[MAX_VAR_NAME_LEN];
-
-	/* function call node */
-	struct Node_t      **func_args;
-	struct Node_t      *callee;
-	struct Node_t      *return_value;
+	int                line;
+
+	/* type of the value of an expression, see carrot_typecheck() */
+	data_type_t        static_type;
+
+	/* variable access, assignment, definition and function definition
+	 * node, filled in by the resolver */
+	resolution_t       var_resolution;
+	int                var_depth;
+	int                var_slot;
+
+	/* script, function definition and loop node */
+	ScopeLayout        *scope_layout;
+
+	union {
+		/* value node */
+		struct {
+			data_type_t        var_type;
+			union {
+				int        int_val;
+				float      float_val;
+				int        bool_val;
+				char       *str_val;
+				NodeList   list_items; // if a list
+			};
+		};
+
+		/* binary operation node, the unary operation node only
+		 * uses right */
+		struct {
+			struct Node_t      *left;
+			struct Node_t      *right;
+			operator_t         op;
+			//                 DT_INT or DT_FLOAT if both operands
+			//                 are known to be of that type
+			data_type_t        operand_type;
+		};
+
+		/* statements node, the root of a script */
+		struct {
+			NodeList           statements;
+			Arena              *arena;
+			ScopeLayout        **layouts; // stb_ds array, made by the resolver
+		};
+
+		/* code block node */
+		NodeList           block_statements;
+
+		/* variable access, assignment, definition and function
+		 * parameter node */
+		struct {
+			char               *var_name;
+			char               *var_type_str;  // definition and parameter
+			data_type_t        var_decl_type;  // same, DT_UNKNOWN if invalid
+			struct Node_t      *var_node;      // assignment and definition
+		};
+
+		/* function definition node */
+		struct {
+			char               *func_name;
+			NodeList           func_params;
+			NodeList           func_statements;
+			char               *func_ret_type_str;
+			data_type_t        func_ret_type;  // DT_UNKNOWN if invalid
+		};
+
+		/* function call node */
+		struct {
+			struct Node_t      *callee;
+			NodeList           func_args;
+		};
+
+		/* item access node */
+		struct {
+			struct Node_t      *list_node;
+			struct Node_t      *index_node;
+		};
+
+		/* if node */
+		struct {
+			//                 The if_blocks.items[i] will be executed
+			//                 if conditions.items[i] is true
+			NodeList           conditions;
+			NodeList           if_blocks;
+			//                 if none of conditions is true then
+			//                 else_block will be executed
+			struct Node_t      *else_block;
+		};
+
+		/* loop node */
+		struct {
+			struct Node_t      *iterable;
+			NodeList           loop_statements;
+			char               *loop_iterator_var_name;
+			char               *loop_index_var_name;
+			int                loop_with_index;
+			int                loop_iterator_slot;
+			int                loop_index_slot;
+		};
+
+		/* return node */
+		struct Node_t      *return_value;
+	};
 } Node;
 
 typedef struct PARSER {
 	Token current_token;
-	int   i;
-	Lexer lexer;
-	int   node_cnt;
-	Node  *nodes[MAX_NODE_NUM];
+	Lexer lexer;      // scans the tokens after current_token on demand
+	Arena *arena;    // handed over to the script node by parser_parse()
 } Parser;
 
-Node *init_node();
-void free_node(Node *node);
+Node *init_node(Parser *parser, node_type_t type);
+void free_node(Node *script);
 Token parser_consume(Parser *parser);
 void parser_free(Parser *parser);
 void parser_init(Parser *parser, char *source);
@@ -138,11 +214,14 @@ Node *parser_parse_statement(Parser *parser);
 Node *parser_parse_statements(Parser *parser);
 Node *parser_parse_term(Parser *parser);
 Node *parser_parse_value(Parser *parser);
-Node *parser_parse_variable_def(Parser *parser,
-		                    Token id_token,
-		                    char *var_type_str, 
-				    Token var_value_token,
-				    int initialized);
+
+typedef void (*node_visitor_t)(void *data, Node *node);
+
+char *operator_to_str(operator_t op);
+data_type_t data_type_from_str(char *type_str);
+char *data_type_to_str(data_type_t type);
+void node_visit_children(Node *node, node_visitor_t visitor, void *data);
+void node_dump(Node *node, int depth);
 
 int  carrot_get_args_len(Node *args);
 void carrot_get_repr(Node obj, char *out);
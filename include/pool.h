@@ -0,0 +1,43 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/* Runtime objects and the small allocations made along with them come
+ * from size classes, one every POOL_GRANULARITY bytes up to
+ * POOL_MAX_SIZE. A class carves its blocks out of slabs and keeps the
+ * freed ones in a free list, so that memory released by the collector
+ * is reused without going through malloc. The interpreter is single
+ * threaded: there are no locks and no per thread caches. Larger
+ * allocations go to malloc. The slabs are only given back to the
+ * system by carrot_pool_finalize(). */
+#define POOL_SLAB_SIZE   (64 * 1024)
+#define POOL_GRANULARITY 16
+#define POOL_MAX_SIZE    256
+#define POOL_CLASS_NUM   (POOL_MAX_SIZE / POOL_GRANULARITY)
+
+typedef struct POOL_STATS {
+	size_t slabs;     // slabs allocated
+	size_t allocs;    // blocks handed out by the size classes
+	size_t reused;    // ... of which came from a free list
+	size_t frees;     // blocks given back to the size classes
+	size_t large;     // allocations left to malloc
+} PoolStats;
+
+extern PoolStats CARROT_POOL_STATS;
+
+/* Sized interface: the size given to carrot_pool_free() must be the one
+ * given when allocating */
+void *carrot_pool_alloc(size_t size);
+void *carrot_pool_calloc(size_t size);
+void carrot_pool_free(void *ptr, size_t size);
+
+/* malloc-like interface, the size is stored in front of the block.
+ * Used by the sds strings, see sdsalloc.h. */
+void *carrot_pool_malloc(size_t size);
+void *carrot_pool_realloc(void *ptr, size_t size);
+void carrot_pool_release(void *ptr);
+
+void carrot_pool_finalize();
+
+#endif
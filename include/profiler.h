@@ -0,0 +1,61 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdatomic.h>
+
+/* Sampling profiler. A SIGPROF timer interrupts the script at a regular
+ * interval of CPU time; each sample records the current Carrot call
+ * stack, the function names and the line each of them is executing.
+ * The samples are written as collapsed stacks, one line per distinct
+ * stack: "<script>:12;fibo:5;fibo:5 42", the format read by the
+ * flamegraph tools. */
+#define PROFILER_DEFAULT_INTERVAL 1000   // microseconds
+#define PROFILER_MAX_DEPTH        256    // deeper frames are not recorded
+
+typedef struct PROFILE_FRAME {
+	const char *name;
+	int        line;
+} ProfileFrame;
+
+/* Call stack of the tree-walking interpreter, the outermost frame is
+ * the script itself. It is kept up to date whether the profiler runs or
+ * not, it costs a store per statement. */
+typedef struct PROFILE_STACK {
+	ProfileFrame frames[PROFILER_MAX_DEPTH];
+	int          depth;   // may exceed PROFILER_MAX_DEPTH
+} ProfileStack;
+
+extern ProfileStack CARROT_PROFILE_STACK;
+
+/* Other engines keep their own call stack and fill frames with at most
+ * max frames, outermost first, when a sample is taken. Called from the
+ * signal handler. */
+typedef int (*carrot_profile_walker_t)(void *data, ProfileFrame *frames, int max);
+
+/* The signal handler may run between any two instructions: a frame is
+ * written before the depth that makes it visible */
+static inline void carrot_profile_enter(const char *name) {
+	int depth = CARROT_PROFILE_STACK.depth;
+	if (depth < PROFILER_MAX_DEPTH) {
+		CARROT_PROFILE_STACK.frames[depth].name = name;
+		CARROT_PROFILE_STACK.frames[depth].line = 0;
+	}
+	atomic_signal_fence(memory_order_release);
+	CARROT_PROFILE_STACK.depth = depth + 1;
+}
+
+static inline void carrot_profile_leave() {
+	CARROT_PROFILE_STACK.depth--;
+}
+
+static inline void carrot_profile_line(int line) {
+	int depth = CARROT_PROFILE_STACK.depth;
+	if (depth <= PROFILER_MAX_DEPTH)
+		CARROT_PROFILE_STACK.frames[depth - 1].line = line;
+}
+
+void carrot_profile_set_walker(carrot_profile_walker_t walker, void *data);
+void carrot_profile_start(char *filename, int interval);
+void carrot_profile_stop();
+
+#endif
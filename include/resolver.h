@@ -0,0 +1,23 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "../include/parser.h"
+#include "../include/interpreter.h"
+
+typedef struct RESOLVER {
+	ScopeLayout **scopes;        // stb_ds array, scopes[0] holds the globals
+	int         function_base;   // innermost function body in scopes
+	Node        **global_refs;   // stb_ds array, globals read by functions
+	Node        *script;         // owns the layouts
+} Resolver;
+
+/* Binds every variable of the script to a slot. References to variables
+ * of the enclosing function (or the script), or to globals, become slot
+ * indexes. Anything else, e.g. a local of the caller, is left to be
+ * looked up by name. So is a global read by a function when a function
+ * or a loop also binds its name, since the local of a caller shadows
+ * the global. The names already bound in globals (the builtins) are
+ * moved into global slots. */
+void resolver_resolve(Node *script, Interpreter *globals);
+
+#endif
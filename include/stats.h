@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include "../include/interpreter.h"
+
+/* Allocation counters, reported by --stats. They are always collected,
+ * each event costs an increment. */
+typedef struct CARROT_STATS {
+	size_t objects[CARROT_DTYPE_NUM];   // CarrotObj's allocated, by type
+	size_t objects_live;
+	size_t objects_peak;                // most objects alive at once
+	size_t objects_released;            // freed when their last reference was dropped
+	size_t bytes_allocated;             // total charged to the collector
+	size_t collections;
+	size_t sds_allocs;                  // sds mallocs and reallocs
+	size_t sds_bytes;
+	size_t sds_largest;                 // largest sds allocation
+	size_t nodes;
+} CarrotStats;
+
+extern CarrotStats CARROT_STATS;
+
+static inline void carrot_stats_count_obj(carrot_dtype_t type) {
+	CARROT_STATS.objects[type]++;
+	if (++CARROT_STATS.objects_live > CARROT_STATS.objects_peak)
+		CARROT_STATS.objects_peak = CARROT_STATS.objects_live;
+}
+
+/* Allocator of the sds strings, see sdsalloc.h */
+void *carrot_sds_malloc(size_t size);
+void *carrot_sds_realloc(void *ptr, size_t size);
+void carrot_sds_free(void *ptr);
+
+/* Writes the counters to stderr, as text or as a JSON object */
+void carrot_stats_print(int json);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "../include/parser.h"
+#include "../include/interpreter.h"
+
+/* What is statically known about a bound variable */
+typedef struct STATIC_VAR {
+	data_type_t type;
+	data_type_t ret_type;    // functions only, DT_UNKNOWN if not known
+	Node        *func_def;   // NULL if not known or builtin
+} StaticVar;
+
+/* stb_ds hashmap keyed by interned names. Holds the variables of a scope
+ * that are bound on every path reaching the current node. */
+typedef struct TYPE_ENV {
+	char      *key;
+	StaticVar value;
+} TypeEnv;
+
+typedef struct TYPE_CHECKER {
+	TypeEnv **scopes;        // stb_ds array, mirrors the resolver scopes
+	int     function_base;   // innermost function body in scopes
+} TypeChecker;
+
+/* Infers the static type of every expression of a resolved script,
+ * following the bindings along the control flow. Operations that are
+ * bound to fail at runtime are reported as errors before execution.
+ * Binary operators on two ints or two floats get an operand_type so
+ * that the engines can skip the dispatch on the runtime types. */
+void carrot_typecheck(Node *script, Interpreter *globals);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef VM_H
+#define VM_H
+
+#include "../include/compiler.h"
+#include "../include/interpreter.h"
+
+#define VM_FRAMES_MAX 1024
+#define VM_STACK_MAX  (VM_FRAMES_MAX * 16)
+#define VM_SCOPES_MAX (VM_FRAMES_MAX * 4)
+#define VM_ITERS_MAX  (VM_FRAMES_MAX * 4)
+#define VM_SLOTS_MAX  (VM_FRAMES_MAX * 64)
+
+typedef struct CALL_FRAME {
+	Chunk       *chunk;
+	uint8_t     *ip;
+	Interpreter *scope;      // innermost scope of this frame
+	CarrotValue *stack_base; // callee and arguments start here
+	int         scope_base;  // scopes owned by this frame start here
+	int         iter_base;   // iter loops owned by this frame start here
+} CallFrame;
+
+/* State of an active iter loop. Loops over a range are counted: the
+ * items are computed from cur and step without going through iter. */
+typedef struct VM_ITER {
+	CarrotIterator iter;
+	int            counted;    // 1 if iterating over a range
+	int            cur;        // next item of a counted loop
+	int            step;
+	int            remaining;  // items left in a counted loop
+} VMIter;
+
+typedef struct VM {
+	CallFrame   frames[VM_FRAMES_MAX];
+	int         frame_cnt;
+
+	CarrotValue stack[VM_STACK_MAX];
+	CarrotValue *sp;
+
+	/* Scopes opened by function calls and iter loops. The global scope
+	 * is owned by the caller of vm_interpret(). */
+	Interpreter scopes[VM_SCOPES_MAX];
+	int         scope_cnt;
+	Interpreter *globals;
+
+	/* Variable slots of the scopes above, allocated like a stack */
+	CarrotValue slots[VM_SLOTS_MAX];
+	CarrotValue *slots_top;
+
+	VMIter      iters[VM_ITERS_MAX];
+	int         iter_cnt;
+
+	/* Reused to pass arguments to builtin functions */
+	CarrotValue *builtin_args;
+	char        *builtin_name;   // builtin being called, for the profiler
+} VM;
+
+CarrotValue vm_interpret(Interpreter *globals, Chunk *chunk);
+
+#endif
@@ -37,6 +37,13 @@
  * the include of your alternate allocator if needed (not needed in order
  * to use the default libc allocator). */
 
-#define s_malloc malloc
-#define s_realloc realloc
-#define s_free free
+/* Carrot counts the sds allocations and takes them from its pool, see
+ * src/stats.c */
+#include <stddef.h>
+void *carrot_sds_malloc(size_t size);
+void *carrot_sds_realloc(void *ptr, size_t size);
+void carrot_sds_free(void *ptr);
+
+#define s_malloc carrot_sds_malloc
+#define s_realloc carrot_sds_realloc
+#define s_free carrot_sds_free
@@ -0,0 +1,43 @@
+"""Generates spec/keywords, the perfect hash table of the keywords
+included by src/lexer.c. Run it whenever a keyword is added:
+
+    python3 gen_keywords.py > keywords
+
+It fails if two keywords share a slot. The hash must match
+KEYWORD_HASH in src/lexer.c."""
+import sys
+
+TABLE_SIZE = 16
+
+keywords = [
+    ("as", "T_AS"),
+    ("elif", "T_ELIF"),
+    ("else", "T_ELSE"),
+    ("end", "T_END"),
+    ("false", "T_FALSE"),
+    ("func", "T_FUNC"),
+    ("if", "T_IF"),
+    ("iter", "T_ITER"),
+    ("return", "T_RETURN"),
+    ("true", "T_TRUE"),
+    ("var", "T_VAR"),
+]
+
+
+def keyword_hash(text):
+    return ((ord(text[0]) << 3) + ord(text[-1]) + len(text)) & (TABLE_SIZE - 1)
+
+
+if __name__ == "__main__":
+    slots = {}
+    for text, kind in keywords:
+        slot = keyword_hash(text)
+        if slot in slots:
+            sys.exit(f"Keywords '{slots[slot][0]}' and '{text}' share slot {slot}, "
+                     "change the hash or the table size")
+        slots[slot] = (text, kind)
+
+    print("/* Generated by spec/gen_keywords.py, do not edit */")
+    for slot in sorted(slots):
+        text, kind = slots[slot]
+        print(f"KEYWORD({slot:2}, \"{text}\", '{text[0]}', '{text[-1]}', {kind})")
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/annotate.h"
+#include "../include/stats.h"
+#include "../lib/include/stb_ds.h"
+
+typedef struct LINE_COST {
+	long   count;
+	long   time_ns;
+	size_t objects;
+	int    active;   // statements of the line being executed
+} LineCost;
+
+/* Statement being executed, the objects allocated by the nested
+ * statements are subtracted from its own */
+typedef struct ANNOTATE_FRAME {
+	size_t nested_objects;
+} AnnotateFrame;
+
+int CARROT_ANNOTATING = 0;
+
+static LineCost      *annotate_lines = NULL;
+static int           annotate_line_cnt = 0;
+static AnnotateFrame *annotate_frames = NULL;   // stb_ds array
+
+static long annotate_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static size_t annotate_objects() {
+	size_t objects = 0;
+	for (int i = 0; i < CARROT_DTYPE_NUM; i++) {
+		objects += CARROT_STATS.objects[i];
+	}
+	return objects;
+}
+
+void carrot_annotate_start(int line_cnt) {
+	/* lines are numbered from 1 */
+	annotate_line_cnt = line_cnt;
+	annotate_lines = calloc(line_cnt + 1, sizeof(LineCost));
+	CARROT_ANNOTATING = 1;
+}
+
+CarrotValue carrot_annotate_visit(Interpreter *context, Node *stmt) {
+	int line = stmt->line;
+	if (line <= 0 || line > annotate_line_cnt)
+		return interpreter_visit(context, stmt);
+
+	LineCost *cost = &annotate_lines[line];
+	cost->count++;
+	cost->active++;
+	arrput(annotate_frames, (AnnotateFrame) {0});
+	size_t objects = annotate_objects();
+	long start = annotate_now();
+
+	CarrotValue result = interpreter_visit(context, stmt);
+
+	long elapsed = annotate_now() - start;
+	objects = annotate_objects() - objects;
+	AnnotateFrame frame = arrpop(annotate_frames);
+	cost->objects += objects - frame.nested_objects;
+	if (arrlen(annotate_frames) > 0)
+		annotate_frames[arrlen(annotate_frames) - 1].nested_objects += objects;
+	if (--cost->active == 0) cost->time_ns += elapsed;
+	return result;
+}
+
+void carrot_annotate_print(char *source) {
+	/* Writes the source to stderr, each line prefixed by its costs */
+	fprintf(stderr, "%10s %12s %10s | source\n", "count", "time (ms)", "objects");
+	char *line_start = source;
+	for (int line = 1; line <= annotate_line_cnt; line++) {
+		char *line_end = line_start;
+		while (*line_end != '\n' && *line_end != '\0') line_end++;
+		if (line_end == line_start && *line_end == '\0') break;
+
+		LineCost *cost = &annotate_lines[line];
+		if (cost->count > 0) {
+			fprintf(stderr, "%10ld %12.3f %10zu | ", cost->count,
+			        cost->time_ns / 1e6, cost->objects);
+		} else {
+			fprintf(stderr, "%10s %12s %10s | ", "", "", "");
+		}
+		fprintf(stderr, "%.*s\n", (int) (line_end - line_start), line_start);
+
+		if (*line_end == '\0') break;
+		line_start = line_end + 1;
+	}
+}
+
+void carrot_annotate_finalize() {
+	free(annotate_lines);
+	arrfree(annotate_frames);
+	annotate_lines = NULL;
+	CARROT_ANNOTATING = 0;
+}
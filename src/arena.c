@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/arena.h"
+
+#define ARENA_ALIGN sizeof(void *)
+
+void arena_init(Arena *arena) {
+	arena->blocks = NULL;
+	arena->allocated = 0;
+}
+
+static ArenaBlock *arena_new_block(Arena *arena, size_t size) {
+	ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+	if (block == NULL) {
+		printf("ERROR: Out of memory\n");
+		exit(1);
+	}
+	block->size = size;
+	block->used = 0;
+	arena->allocated += sizeof(ArenaBlock) + size;
+	return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+	/* Returns zeroed memory, aligned for any pointer or scalar field */
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	ArenaBlock *block = arena->blocks;
+	if (block == NULL || block->used + size > block->size) {
+		if (size > ARENA_BLOCK_SIZE / 4) {
+			/* keep filling the current block, the big one goes
+			 * behind it */
+			ArenaBlock *big = arena_new_block(arena, size);
+			if (block == NULL) {
+				big->next = NULL;
+				arena->blocks = big;
+			} else {
+				big->next = block->next;
+				block->next = big;
+			}
+			block = big;
+		} else {
+			block = arena_new_block(arena, ARENA_BLOCK_SIZE);
+			block->next = arena->blocks;
+			arena->blocks = block;
+		}
+	}
+
+	void *mem = block->data + block->used;
+	block->used += size;
+	memset(mem, 0, size);
+	return mem;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+	size_t len = strlen(s);
+	char *copy = arena_alloc(arena, len + 1);
+	memcpy(copy, s, len);
+	return copy;
+}
+
+void arena_free(Arena *arena) {
+	ArenaBlock *block = arena->blocks;
+	while (block != NULL) {
+		ArenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->blocks = NULL;
+	arena->allocated = 0;
+}
@@ -1,27 +1,42 @@
 #include <stdio.h>
 #include "../include/interpreter.h"
 #include "../include/builtin_func.h"
+#include "../include/intern.h"
+#include "../include/output.h"
 #include "../lib/include/stb_ds.h"
 
-CarrotObj *carrot_func_print(CarrotObj **args) {
+CarrotValue carrot_func_print(CarrotValue *args) {
 	int argc = arrlen(args);
 	for (int i = 0; i < argc; i++) {
-		printf("%s", args[i]->repr);
+		carrot_output_value(args[i]);
 	}
 	return carrot_null();
 }
 
-CarrotObj *carrot_func_println(CarrotObj **args) {
+CarrotValue carrot_func_println(CarrotValue *args) {
 	int argc = arrlen(args);
 	for (int i = 0; i < argc; i++) {
-		printf("%s", args[i]->repr);
+		carrot_output_value(args[i]);
 	}
-	printf("\n");
+	carrot_output_write("\n", 1);
 	return carrot_null();
 }
 
-CarrotObj *carrot_func_range(CarrotObj **args) {
-	if (arrlen(args) < 1 || arrlen(args) > 3) {
+CarrotValue carrot_func_flush(CarrotValue *args) {
+	/* Writes out the output buffered so far, whatever the policy */
+	int argc = arrlen(args);
+	if (argc != 0) {
+		printf("ERROR: Function 'flush' accepts no arguments, but %d are passed.\n", argc);
+		exit(1);
+	}
+	carrot_output_flush();
+	return carrot_null();
+}
+
+void carrot_range_args(CarrotValue *args, int argc, int *start, int *stop, int *step) {
+	/* Checks the arguments of range(). Also used by the loops over
+	 * range(...), which iterate without creating the range. */
+	if (argc < 1 || argc > 3) {
 		printf("ERROR: Function 'range' accepts 1, 2 or 3 arguments.\n");
 		printf("       Usage: `range(upper_bound) or range(lower_bound, upper_bound)`\n");
 		printf("       or range(lower_bound, upper_bound, step).\n");
@@ -29,55 +44,62 @@ CarrotObj *carrot_func_range(CarrotObj **args) {
 	}
 
 	int all_int = 1;
-	for (int i = 0; i < arrlen(args); i++) {
-		all_int = all_int && (args[i]->type == CARROT_INT);
+	for (int i = 0; i < argc; i++) {
+		all_int = all_int && (args[i].type == CARROT_INT);
 	}
 	if (!all_int) {
 		printf("ERROR: All arguments for `range` should be of `int` type\n");
 		exit(1);
 	}
 
-	CarrotObj **list_items = NULL;
-
-	if (arrlen(args) == 1) {
-		for (int i = 0; i < args[0]->int_val; i++) {
-			arrput(list_items, carrot_int(i));
-		}
-		return carrot_list(list_items);
+	*start = argc == 1 ? 0 : args[0].int_val;
+	*stop = argc == 1 ? args[0].int_val : args[1].int_val;
+	*step = argc == 3 ? args[2].int_val : 1;
+	if (*step == 0) {
+		printf("ERROR: The step of `range` cannot be 0\n");
+		exit(1);
 	}
+}
 
-	int step = 1;
-	if (arrlen(args) == 3) {
-		step = args[2]->int_val;
-	}
+CarrotValue carrot_func_range(CarrotValue *args) {
+	/* The items are computed on demand, see CARROT_RANGE */
+	int start, stop, step;
+	carrot_range_args(args, arrlen(args), &start, &stop, &step);
+	return carrot_range(start, stop, step);
+}
 
-	int low = args[0]->int_val;
-	int high = args[1]->int_val;
-	for (int i = low; i < high; i += step) {
-		arrput(list_items, carrot_int(i));
-	}
-	return carrot_list(list_items);
+int carrot_is_range_func(CarrotValue value) {
+	return value.type == CARROT_FUNCTION &&
+	       value.obj->builtin_func == carrot_func_range;
 }
 
-CarrotObj *carrot_func_type(CarrotObj **args) {
+CarrotValue carrot_func_type(CarrotValue *args) {
 	int argc = arrlen(args);
 	if (argc != 1) {
 		printf("ERROR: Function 'type' accepts exactly 1 arguments, but %d are passed.\n", argc);
 		exit(1);
 	}
-	return carrot_str(args[0]->type_str);
+	return carrot_str_const(carrot_intern(carrot_type_str(args[0])));
+}
+
+data_type_t carrot_builtin_ret_type(CarrotObj *builtin) {
+	/* Type of the values returned by a builtin, see carrot_typecheck() */
+	if (builtin->builtin_func == carrot_func_print ||
+	    builtin->builtin_func == carrot_func_println ||
+	    builtin->builtin_func == carrot_func_flush) return DT_NULL;
+	if (builtin->builtin_func == carrot_func_range) return DT_LIST;
+	if (builtin->builtin_func == carrot_func_type) return DT_STR;
+	return DT_UNKNOWN;
 }
 
 void carrot_register_builtin_func(char *name,
-		                  CarrotObj *(*func)(CarrotObj **args),
+		                  CarrotValue (*func)(CarrotValue *args),
 		                  Interpreter *interpreter) {
-	CarrotObj *builtin_func = carrot_obj_allocate();
-	builtin_func->type = CARROT_FUNCTION;
+	CarrotObj *builtin_func = carrot_obj_allocate(CARROT_FUNCTION);
 	builtin_func->builtin_func = func;
-	builtin_func->is_builtin = 1;
-	builtin_func->repr = sdsnew("function");
-	strcpy(builtin_func->func_name, name);
-	shput(interpreter->sym_table, name, builtin_func);
+	builtin_func->func_name = name;
+	hmput(interpreter->sym_table, carrot_intern(name),
+	      carrot_obj_value(builtin_func));
 }
 
 void carrot_register_all_builtin_func(Interpreter *interpreter) {
@@ -87,6 +109,9 @@ void carrot_register_all_builtin_func(Interpreter *interpreter) {
 	carrot_register_builtin_func("println",
 				     &carrot_func_println,
 				     interpreter);
+	carrot_register_builtin_func("flush",
+				     carrot_func_flush,
+				     interpreter);
 	carrot_register_builtin_func("range",
 				     carrot_func_range,
 				     interpreter);
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/compiler.h"
+#include "../include/intern.h"
+#include "../lib/include/stb_ds.h"
+
+static void compile_expression(Chunk *chunk, Node *node);
+static void compile_statement(Chunk *chunk, Node *node);
+
+static void emit_byte(Chunk *chunk, uint8_t byte) {
+	arrput(chunk->code, byte);
+	arrput(chunk->lines, chunk->line);
+}
+
+static void emit_short(Chunk *chunk, int operand) {
+	if (operand > MAX_CHUNK_OPERAND) {
+		printf("ERROR: Script is too large to compile (operand %d)\n",
+		       operand);
+		exit(1);
+	}
+	emit_byte(chunk, (operand >> 8) & 0xff);
+	emit_byte(chunk, operand & 0xff);
+}
+
+static void emit_op_short(Chunk *chunk, opcode_t op, int operand) {
+	emit_byte(chunk, op);
+	emit_short(chunk, operand);
+}
+
+static int add_constant(Chunk *chunk, CarrotValue value) {
+	arrput(chunk->constants, value);
+	return arrlen(chunk->constants) - 1;
+}
+
+static int add_name(Chunk *chunk, char *name) {
+	for (int i = 0; i < arrlen(chunk->names); i++) {
+		if (strcmp(chunk->names[i], name) == 0) return i;
+	}
+	arrput(chunk->names, name);
+	return arrlen(chunk->names) - 1;
+}
+
+/* Emits a forward jump with a placeholder offset and returns the
+ * position of the offset so it can be patched later */
+static int emit_jump(Chunk *chunk, opcode_t op) {
+	emit_op_short(chunk, op, 0);
+	return arrlen(chunk->code) - 2;
+}
+
+static void patch_jump(Chunk *chunk, int offset_pos) {
+	/* the offset is relative to the instruction following the jump */
+	int jump = arrlen(chunk->code) - offset_pos - 2;
+	if (jump > MAX_CHUNK_OPERAND) {
+		printf("ERROR: Too much code to jump over\n");
+		exit(1);
+	}
+	chunk->code[offset_pos] = (jump >> 8) & 0xff;
+	chunk->code[offset_pos + 1] = jump & 0xff;
+}
+
+static Chunk *chunk_new(char *name) {
+	Chunk *chunk = malloc(sizeof(Chunk));
+	chunk->name = name;
+	chunk->code = NULL;
+	chunk->lines = NULL;
+	chunk->line = 0;
+	chunk->constants = NULL;
+	chunk->names = NULL;
+	chunk->layouts = NULL;
+	return chunk;
+}
+
+static void compile_literal(Chunk *chunk, Node *node) {
+	CarrotValue constant;
+	if (node->var_type == DT_STR) {
+		constant = carrot_str_const(node->str_val);
+	} else if (node->var_type == DT_INT) {
+		constant = carrot_int(node->int_val);
+	} else if (node->var_type == DT_FLOAT) {
+		constant = carrot_float(node->float_val);
+	} else if (node->var_type == DT_BOOL) {
+		constant = carrot_bool(node->bool_val);
+	} else if (node->var_type == DT_NULL) {
+		constant = carrot_null();
+	} else if (node->var_type == DT_LIST) {
+		int item_cnt = node->list_items.len;
+		for (int i = 0; i < item_cnt; i++) {
+			compile_expression(chunk, node->list_items.items[i]);
+		}
+		emit_op_short(chunk, OP_BUILD_LIST, item_cnt);
+		return;
+	} else {
+		printf("The data type %d is not supported yet", node->var_type);
+		exit(1);
+	}
+	emit_op_short(chunk, OP_CONST, add_constant(chunk, constant));
+}
+
+static int binding_slot(Node *node) {
+	/* Definitions and assignments bind in the current scope, so the
+	 * resolver always gives them a local slot */
+	if (node->var_resolution != RES_LOCAL) {
+		printf("ERROR: Cannot compile unresolved variable %s\n",
+		       node->var_name);
+		exit(1);
+	}
+	return node->var_slot;
+}
+
+static void compile_var_access(Chunk *chunk, Node *node) {
+	int name = add_name(chunk, node->var_name);
+	switch (node->var_resolution) {
+		case RES_LOCAL:
+			if (node->var_depth > 255) {
+				printf("ERROR: Too many nested scopes\n");
+				exit(1);
+			}
+			emit_byte(chunk, OP_GET_LOCAL);
+			emit_byte(chunk, node->var_depth);
+			emit_short(chunk, node->var_slot);
+			emit_short(chunk, name);
+			break;
+		case RES_GLOBAL:
+			emit_op_short(chunk, OP_GET_GLOBAL, node->var_slot);
+			emit_short(chunk, name);
+			break;
+		case RES_DYNAMIC:
+			emit_op_short(chunk, OP_GET_VAR, name);
+			break;
+	}
+}
+
+static int compile_call_operands(Chunk *chunk, Node *node) {
+	/* Pushes the callee and the arguments, returns the argument count */
+	int argc = node->func_args.len;
+	if (argc > 255) {
+		printf("ERROR: Cannot pass more than 255 arguments\n");
+		exit(1);
+	}
+
+	compile_expression(chunk, node->callee);
+	for (int i = 0; i < argc; i++) {
+		compile_expression(chunk, node->func_args.items[i]);
+	}
+	return argc;
+}
+
+static void compile_func_call(Chunk *chunk, Node *node) {
+	int argc = compile_call_operands(chunk, node);
+	emit_byte(chunk, OP_CALL);
+	emit_byte(chunk, argc);
+}
+
+static void compile_expression(Chunk *chunk, Node *node) {
+	switch (node->type) {
+		case N_LITERAL:
+			compile_literal(chunk, node);
+			return;
+		case N_BINOP:
+			compile_expression(chunk, node->left);
+			compile_expression(chunk, node->right);
+			if (node->operand_type == DT_INT)
+				emit_byte(chunk, OP_BINARY_INT);
+			else if (node->operand_type == DT_FLOAT)
+				emit_byte(chunk, OP_BINARY_FLOAT);
+			else
+				emit_byte(chunk, OP_BINARY);
+			emit_byte(chunk, node->op);
+			return;
+		case N_UNOP:
+			compile_expression(chunk, node->right);
+			if (node->op == OPR_NOT) {
+				emit_byte(chunk, OP_NOT);
+			} else if (node->op == OPR_NEGATE) {
+				emit_byte(chunk, OP_NEGATE);
+			}
+			/* unary "+" leaves its operand untouched */
+			return;
+		case N_VAR_ACCESS:
+			compile_var_access(chunk, node);
+			return;
+		case N_VAR_ASSIGN:
+			compile_expression(chunk, node->var_node);
+			emit_op_short(chunk, OP_SET_LOCAL, binding_slot(node));
+			return;
+		case N_FUNC_CALL:
+			compile_func_call(chunk, node);
+			return;
+		case N_GET_ITEM:
+			compile_expression(chunk, node->list_node);
+			compile_expression(chunk, node->index_node);
+			emit_byte(chunk, OP_GET_ITEM);
+			return;
+		default:
+			/* Statement-only nodes evaluate to null, the same way
+			 * interpreter_visit treats them */
+			compile_statement(chunk, node);
+			emit_op_short(chunk, OP_CONST,
+			              add_constant(chunk, carrot_null()));
+			return;
+	}
+}
+
+static void compile_block(Chunk *chunk, NodeList statements) {
+	for (int i = 0; i < statements.len; i++) {
+		compile_statement(chunk, statements.items[i]);
+	}
+}
+
+static void compile_func_def(Chunk *chunk, Node *node) {
+	Chunk *body = chunk_new(node->func_name);
+	compile_block(body, node->func_statements);
+
+	/* falling off the end of a function returns null */
+	emit_op_short(body, OP_CONST, add_constant(body, carrot_null()));
+	emit_byte(body, OP_RETURN);
+
+	CarrotObj *function = carrot_obj_allocate(CARROT_FUNCTION);
+	function->func_def = node;
+	function->func_chunk = body;
+	function->func_name = node->func_name;
+	emit_op_short(chunk, OP_DEF_FUNC,
+	              add_constant(chunk, carrot_obj_value(function)));
+	emit_short(chunk, binding_slot(node));
+}
+
+static void compile_if(Chunk *chunk, Node *node) {
+	int *end_jumps = NULL;
+	for (int i = 0; i < node->conditions.len; i++) {
+		compile_expression(chunk, node->conditions.items[i]);
+		int next_condition = emit_jump(chunk, OP_JUMP_IF_FALSE);
+		compile_statement(chunk, node->if_blocks.items[i]);
+		arrput(end_jumps, emit_jump(chunk, OP_JUMP));
+		patch_jump(chunk, next_condition);
+	}
+
+	if (node->else_block != NULL)
+		compile_statement(chunk, node->else_block);
+
+	for (int i = 0; i < arrlen(end_jumps); i++) {
+		patch_jump(chunk, end_jumps[i]);
+	}
+	arrfree(end_jumps);
+}
+
+static int is_range_call(Node *node) {
+	return node->type == N_FUNC_CALL &&
+	       node->callee->type == N_VAR_ACCESS &&
+	       node->callee->var_name == carrot_intern("range");
+}
+
+static void compile_iter(Chunk *chunk, Node *node) {
+	arrput(chunk->layouts, node->scope_layout);
+	int layout = arrlen(chunk->layouts) - 1;
+
+	/* A loop over range(...) does not need the range object. If the
+	 * callee turns out to be the builtin, OP_ITER_RANGE starts a
+	 * counted loop and jumps over the call and OP_ITER_BEGIN. */
+	int range_jump = -1;
+	if (is_range_call(node->iterable)) {
+		int argc = compile_call_operands(chunk, node->iterable);
+		emit_byte(chunk, OP_ITER_RANGE);
+		emit_byte(chunk, argc);
+		emit_short(chunk, layout);
+		range_jump = arrlen(chunk->code);
+		emit_short(chunk, 0);
+		emit_byte(chunk, OP_CALL);
+		emit_byte(chunk, argc);
+	} else {
+		compile_expression(chunk, node->iterable);
+	}
+	emit_op_short(chunk, OP_ITER_BEGIN, layout);
+	if (range_jump >= 0) patch_jump(chunk, range_jump);
+
+	/* The loop is entered at its end: OP_ITER_NEXT jumps back to the
+	 * body as long as there are items, one dispatch per iteration */
+	int enter_jump = emit_jump(chunk, OP_JUMP);
+	int body_start = arrlen(chunk->code);
+	compile_block(chunk, node->loop_statements);
+
+	patch_jump(chunk, enter_jump);
+	chunk->line = node->line;
+	emit_op_short(chunk, OP_ITER_NEXT, node->loop_iterator_slot);
+	if (node->loop_with_index)
+		emit_short(chunk, node->loop_index_slot);
+	else
+		emit_short(chunk, CHUNK_NO_SLOT);
+	emit_short(chunk, arrlen(chunk->code) - body_start + 2);
+	emit_byte(chunk, OP_ITER_END);
+}
+
+static void compile_statement(Chunk *chunk, Node *node) {
+	if (node->line > 0) chunk->line = node->line;
+	switch (node->type) {
+		case N_STATEMENTS:
+			compile_block(chunk, node->statements);
+			return;
+		case N_BLOCK:
+			compile_block(chunk, node->block_statements);
+			return;
+		case N_VAR_DEF:
+			compile_expression(chunk, node->var_node);
+			emit_op_short(chunk, OP_DEF_LOCAL, binding_slot(node));
+			emit_short(chunk, add_name(chunk, node->var_name));
+			return;
+		case N_FUNC_DEF:
+			compile_func_def(chunk, node);
+			return;
+		case N_IF:
+			compile_if(chunk, node);
+			return;
+		case N_ITER:
+			compile_iter(chunk, node);
+			return;
+		case N_RETURN:
+			compile_expression(chunk, node->return_value);
+			emit_byte(chunk, OP_RETURN);
+			return;
+		case N_LITERAL:
+		case N_BINOP:
+		case N_UNOP:
+		case N_VAR_ACCESS:
+		case N_VAR_ASSIGN:
+		case N_FUNC_CALL:
+		case N_GET_ITEM:
+			compile_expression(chunk, node);
+			emit_byte(chunk, OP_POP);
+			return;
+		case N_STATEMENT:
+		case N_FUNC_PARAM:
+		case N_NULL:
+		case N_UNKNOWN:
+			break;
+	}
+	printf("%s\n", "ERROR: Unknown node");
+	printf("%d\n", node->type);
+	exit(1);
+}
+
+/*===========================================================================
+ * Bytecode compilation
+ *===========================================================================*/
+Chunk *compiler_compile(Node *node) {
+	Chunk *chunk = chunk_new("<script>");
+	compile_statement(chunk, node);
+
+	emit_op_short(chunk, OP_CONST, add_constant(chunk, carrot_null()));
+	emit_byte(chunk, OP_RETURN);
+	return chunk;
+}
+
+void chunk_free(Chunk *chunk) {
+	/* The heap constants themselves are tracked CarrotObj's and are
+	 * released by carrot_finalize(). Only the bodies of function
+	 * constants are owned by the chunk. */
+	for (int i = 0; i < arrlen(chunk->constants); i++) {
+		CarrotValue constant = chunk->constants[i];
+		if (constant.type == CARROT_FUNCTION &&
+		    constant.obj->func_chunk != NULL) {
+			chunk_free(constant.obj->func_chunk);
+			constant.obj->func_chunk = NULL;
+		}
+	}
+	arrfree(chunk->code);
+	arrfree(chunk->lines);
+	arrfree(chunk->constants);
+	arrfree(chunk->names);
+	arrfree(chunk->layouts);
+	free(chunk);
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/gc.h"
+#include "../include/compiler.h"
+#include "../include/stats.h"
+#include "../lib/include/stb_ds.h"
+
+int CARROT_GC_REQUESTED = 0;
+
+static size_t     gc_threshold = CARROT_GC_DEFAULT_THRESHOLD;
+static double     gc_growth = CARROT_GC_DEFAULT_GROWTH;
+static size_t     gc_bytes_allocated = 0;
+static size_t     gc_next_collection = CARROT_GC_DEFAULT_THRESHOLD;
+
+static Interpreter **gc_scopes = NULL;   // stb_ds array
+static CarrotValue *gc_roots = NULL;     // stb_ds array
+static GCMarker    *gc_markers = NULL;   // stb_ds array
+static CarrotObj   **gc_gray = NULL;     // stb_ds array
+
+void carrot_gc_configure(size_t threshold, double growth) {
+	gc_threshold = threshold;
+	gc_growth = growth;
+	gc_next_collection = threshold;
+}
+
+void carrot_gc_account(size_t size) {
+	/* Called whenever an object grows by size bytes. The total is given
+	 * back by carrot_gc_release() using carrot_obj_size(). */
+	gc_bytes_allocated += size;
+	CARROT_STATS.bytes_allocated += size;
+	if (gc_bytes_allocated > gc_next_collection) CARROT_GC_REQUESTED = 1;
+}
+
+void carrot_gc_mark_value(CarrotValue value) {
+	if (!carrot_is_heap_type(value.type) || value.obj->marked) return;
+	value.obj->marked = 1;
+	arrput(gc_gray, value.obj);
+}
+
+void carrot_gc_mark_scope(Interpreter *scope) {
+	for (int i = 0; i < scope_layout_size(scope->layout); i++) {
+		carrot_gc_mark_value(scope->slots[i]);
+	}
+	for (int i = 0; i < hmlen(scope->sym_table); i++) {
+		carrot_gc_mark_value(scope->sym_table[i].value);
+	}
+}
+
+static void gc_trace(CarrotObj *obj) {
+	if (obj->type == CARROT_LIST) {
+		for (int i = 0; i < arrlen(obj->list_items); i++) {
+			carrot_gc_mark_value(obj->list_items[i]);
+		}
+	} else if (obj->type == CARROT_FUNCTION && obj->func_chunk != NULL) {
+		Chunk *chunk = obj->func_chunk;
+		for (int i = 0; i < arrlen(chunk->constants); i++) {
+			carrot_gc_mark_value(chunk->constants[i]);
+		}
+	}
+}
+
+static void gc_mark_roots() {
+	for (int i = 0; i < arrlen(gc_scopes); i++) {
+		carrot_gc_mark_scope(gc_scopes[i]);
+	}
+	for (int i = 0; i < arrlen(gc_roots); i++) {
+		carrot_gc_mark_value(gc_roots[i]);
+	}
+	for (int i = 0; i < arrlen(gc_markers); i++) {
+		gc_markers[i].marker(gc_markers[i].data);
+	}
+}
+
+static void gc_sweep() {
+	/* carrot_free() unlinks obj, so its successor is read first */
+	CarrotObj *obj = CARROT_HEAP_OBJS;
+	while (obj != NULL) {
+		CarrotObj *next = obj->next;
+		if (obj->marked) {
+			obj->marked = 0;
+		} else {
+			carrot_free(obj);
+		}
+		obj = next;
+	}
+}
+
+/*===========================================================================
+ * Mark and sweep
+ *===========================================================================*/
+void carrot_gc_collect() {
+	CARROT_STATS.collections++;
+	gc_mark_roots();
+	while (arrlen(gc_gray) > 0) {
+		gc_trace(arrpop(gc_gray));
+	}
+	gc_sweep();
+
+	gc_next_collection = gc_bytes_allocated * gc_growth;
+	if (gc_next_collection < gc_threshold)
+		gc_next_collection = gc_threshold;
+	CARROT_GC_REQUESTED = 0;
+}
+
+void carrot_gc_release(CarrotObj *obj) {
+	gc_bytes_allocated -= carrot_obj_size(obj);
+}
+
+void carrot_gc_finalize() {
+	arrfree(gc_scopes);
+	arrfree(gc_roots);
+	arrfree(gc_markers);
+	arrfree(gc_gray);
+	gc_bytes_allocated = 0;
+}
+
+void carrot_gc_push_scope(Interpreter *scope) {
+	arrput(gc_scopes, scope);
+}
+
+void carrot_gc_pop_scope() {
+	arrsetlen(gc_scopes, arrlen(gc_scopes) - 1);
+}
+
+void carrot_gc_push_root(CarrotValue value) {
+	arrput(gc_roots, value);
+}
+
+void carrot_gc_pop_roots(int n) {
+	arrsetlen(gc_roots, arrlen(gc_roots) - n);
+}
+
+void carrot_gc_add_marker(carrot_gc_marker_t marker, void *data) {
+	GCMarker m = {marker, data};
+	arrput(gc_markers, m);
+}
+
+void carrot_gc_remove_marker(carrot_gc_marker_t marker, void *data) {
+	for (int i = 0; i < arrlen(gc_markers); i++) {
+		if (gc_markers[i].marker == marker && gc_markers[i].data == data) {
+			arrdel(gc_markers, i);
+			return;
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/intern.h"
+#include "../lib/include/stb_ds.h"
+
+typedef struct INTERN_ENTRY {
+	char *key;
+	char value;  // unused
+} InternEntry;
+
+/* The keys are copied into the string arena of stb_ds, which never
+ * moves them */
+static InternEntry *intern_table = NULL;
+
+char *carrot_intern(const char *s) {
+	if (intern_table == NULL) sh_new_arena(intern_table);
+
+	ptrdiff_t idx = shgeti(intern_table, (char *) s);
+	if (idx < 0) {
+		shput(intern_table, (char *) s, 0);
+		idx = shgeti(intern_table, (char *) s);
+	}
+	return intern_table[idx].key;
+}
+
+char *carrot_intern_len(const char *s, int len) {
+	/* Interns the first len characters of s, e.g. a span of the source.
+	 * The table needs a terminated key, short ones are copied on the
+	 * stack. */
+	char buf[64];
+	char *key = len < (int) sizeof(buf) ? buf : malloc(len + 1);
+	memcpy(key, s, len);
+	key[len] = '\0';
+	char *interned = carrot_intern(key);
+	if (key != buf) free(key);
+	return interned;
+}
+
+void carrot_intern_finalize() {
+	shfree(intern_table);
+	intern_table = NULL;
+}
@@ -1,23 +1,73 @@
 #include <stdio.h>
 #include "../include/logutils.h"
 #include "../include/interpreter.h"
+#include "../include/intern.h"
+#include "../include/builtin_func.h"
+#include "../include/gc.h"
+#include "../include/profiler.h"
+#include "../include/annotate.h"
+#include "../include/stats.h"
+#include "../include/pool.h"
 #include "../lib/include/stb_ds.h"
 
-SymTable *CARROT_TRACKING_ARR;
+CarrotObj *CARROT_HEAP_OBJS;
+
+/* Immortal string objects keyed by their interned text, see
+ * carrot_str_const() */
+static ObjTable *CARROT_STR_CONSTS;
+
 
 Interpreter create_interpreter() {
 	Interpreter interpreter;
 	interpreter.parent = NULL;
 	interpreter.sym_table = NULL;
+	interpreter.globals = NULL;
+	interpreter.layout = NULL;
+	interpreter.slots = NULL;
 	//sh_new_strdup(interpreter.sym_table);
 	return interpreter;
 }
 
-CarrotObj *interpreter_interpret(Interpreter *interpreter, Node *node) {
+void interpreter_open_scope(Interpreter *scope,
+		            Interpreter *parent,
+		            ScopeLayout *layout,
+		            CarrotValue *slots) {
+	/* slots must have room for every variable of layout */
+	scope->sym_table = NULL;
+	scope->parent = parent;
+	scope->globals = parent != NULL ? parent->globals : NULL;
+	scope->layout = layout;
+	scope->slots = slots;
+	for (int i = 0; i < scope_layout_size(layout); i++) {
+		slots[i] = carrot_undefined();
+	}
+}
+
+void interpreter_use_layout(Interpreter *globals, ScopeLayout *layout) {
+	/* Gives the global scope its slots and moves the variables already
+	 * bound by name (the builtins) into them */
+	int slot_cnt = scope_layout_size(layout);
+	globals->globals = globals;
+	globals->layout = layout;
+	globals->slots = malloc((slot_cnt + 1) * sizeof(CarrotValue));
+	for (int i = 0; i < slot_cnt; i++) {
+		globals->slots[i] = carrot_undefined();
+	}
+
+	for (ptrdiff_t i = hmlen(globals->sym_table) - 1; i >= 0; i--) {
+		char *var_name = globals->sym_table[i].key;
+		ptrdiff_t idx = hmgeti(layout->slots, var_name);
+		if (idx < 0) continue;
+		globals->slots[layout->slots[idx].value] = globals->sym_table[i].value;
+		hmdel(globals->sym_table, var_name);
+	}
+}
+
+CarrotValue interpreter_interpret(Interpreter *interpreter, Node *node) {
 	return interpreter_visit(interpreter, node);
 }
 
-CarrotObj *interpreter_visit(Interpreter *context, Node *node) {
+CarrotValue interpreter_visit(Interpreter *context, Node *node) {
 	switch (node->type) {
 		case N_BINOP:
 			return interpreter_visit_binop(context, node);
@@ -49,6 +99,7 @@ CarrotObj *interpreter_visit(Interpreter *context, Node *node) {
 			return interpreter_visit_unop(context, node);
 		// TODO: complete missing cases
 		case N_STATEMENT:
+		case N_FUNC_PARAM:
 		case N_NULL: 
 		case N_UNKNOWN: 
 			break;
@@ -58,147 +109,175 @@ CarrotObj *interpreter_visit(Interpreter *context, Node *node) {
 	exit(1);
 }
 
-CarrotObj *interpreter_visit_binop(Interpreter *context, Node *node) {
-	CarrotObj *left = interpreter_visit(context, node->left);
-	CarrotObj *right = interpreter_visit(context, node->right);
-	if (strcmp(node->op_str, "+") == 0) {
-		if (left->__add != NULL) return left->__add(left, right);
-	} else if (strcmp(node->op_str, "-") == 0) {
-		if (left->__subtract != NULL) return left->__subtract(left, right);
-	} else if (strcmp(node->op_str, "*") == 0) {
-		if (left->__mult != NULL) return left->__mult(left, right);
-	} else if (strcmp(node->op_str, "/") == 0) {
-		if (left->__div != NULL) return left->__div(left, right);
-	} else if (strcmp(node->op_str, "==") == 0) {
-		if (left->__ee != NULL) return left->__ee(left, right);
-	} else if (strcmp(node->op_str, "!=") == 0) {
-		if (left->__ne != NULL) return left->__ne(left, right);
-	} else if (strcmp(node->op_str, ">") == 0) {
-		if (left->__gt != NULL) return left->__gt(left, right);
-	} else if (strcmp(node->op_str, "<") == 0) {
-		if (left->__lt != NULL) return left->__lt(left, right);
-	} else if (strcmp(node->op_str, ">=") == 0) {
-		if (left->__ge != NULL) return left->__ge(left, right);
-	} else if (strcmp(node->op_str, "<=") == 0) {
-		if (left->__le != NULL) return left->__le(left, right);
-	} else if (strcmp(node->op_str, "&&") == 0) {
-		if (left->__and != NULL) return left->__and(left, right);
-	} else if (strcmp(node->op_str, "||") == 0) {
-		if (left->__or != NULL) return left->__or(left, right);
-	}  
+CarrotValue interpreter_visit_binop(Interpreter *context, Node *node) {
+	/* Immediate operands of a known type need neither roots nor dispatch */
+	if (node->operand_type == DT_INT) {
+		int left = interpreter_visit(context, node->left).int_val;
+		return carrot_int_binop(node->op, left,
+		                        interpreter_visit(context, node->right).int_val);
+	} else if (node->operand_type == DT_FLOAT) {
+		float left = interpreter_visit(context, node->left).float_val;
+		return carrot_float_binop(node->op, left,
+		                          interpreter_visit(context, node->right).float_val);
+	}
 
-	printf("ERROR: operator %s is not defined for type %s and %s\n",
-	       node->op_str, left->type_str, right->type_str);
-	exit(1);
+	CarrotValue left = interpreter_visit(context, node->left);
+	carrot_gc_push_root(left);
+	CarrotValue right = interpreter_visit(context, node->right);
+	carrot_gc_pop_roots(1);
+	CarrotValue result = carrot_binop(node->op, left, right);
+	carrot_decref(left);
+	carrot_decref(right);
+	return result;
+}
+
+static CarrotValue interpreter_visit_statement(Interpreter *context, Node *stmt) {
+	/* Statement boundaries are the safepoints of the collector, and
+	 * where the profilers learn the current line */
+	carrot_gc_safepoint();
+	carrot_profile_line(stmt->line);
+	if (CARROT_ANNOTATING) return carrot_annotate_visit(context, stmt);
+	return interpreter_visit(context, stmt);
 }
 
-CarrotObj *interpreter_visit_block(Interpreter *context, Node *node) {
-	for (int i = 0; i < arrlen(node->block_statements); i++) {
-		interpreter_visit(context, node->block_statements[i]);
+CarrotValue interpreter_visit_block(Interpreter *context, Node *node) {
+	for (int i = 0; i < node->block_statements.len; i++) {
+		carrot_decref(interpreter_visit_statement(context,
+		                                          node->block_statements.items[i]));
 	}
 	return carrot_null();
 }
 
-CarrotObj *interpreter_visit_func_call(Interpreter *context, Node *node) {
-	CarrotObj *func_to_call = interpreter_visit(context, node->callee);
+CarrotValue interpreter_visit_func_call(Interpreter *context, Node *node) {
+	CarrotValue callee = interpreter_visit(context, node->callee);
+	if (callee.type != CARROT_FUNCTION) {
+		printf("ERROR: %s is not callable\n", carrot_type_str(callee));
+		exit(1);
+	}
+	CarrotObj *func_to_call = callee.obj;
+	carrot_gc_push_root(callee);
 
-	if (func_to_call->is_builtin) {
+	if (func_to_call->builtin_func != NULL) {
 		/* Case 1: the function being called is a builtin function */
-		CarrotObj **func_args = NULL;
-		for (int i = 0; i < arrlen(node->func_args); i++) {
-			CarrotObj *itprtd = interpreter_visit(context, node->func_args[i]);
+		CarrotValue *func_args = NULL;
+		for (int i = 0; i < node->func_args.len; i++) {
+			CarrotValue itprtd = interpreter_visit(context,
+			                                       node->func_args.items[i]);
+			carrot_gc_push_root(itprtd);
 			arrput(func_args, itprtd);
 		}
-		CarrotObj *res = func_to_call->builtin_func(func_args);
-
-		/* Clean up the evaluated arguments and its representation after
-		 * built-in function call */
-		//for (int i = 0; i < arrlen(func_args); i++) sdsfree(func_args[i].repr);
+		carrot_profile_enter(func_to_call->func_name);
+		CarrotValue res = func_to_call->builtin_func(func_args);
+		carrot_profile_leave();
+		carrot_gc_pop_roots(arrlen(func_args) + 1);
+
+		/* Clean up the evaluated arguments after built-in function call */
+		for (int i = 0; i < arrlen(func_args); i++) {
+			carrot_decref(func_args[i]);
+		}
 		if (func_args != NULL) arrfree(func_args);
+		carrot_decref(callee);
 		return res;
 	} else {
 		/* Case 2: the function being called is made inside carrot script */
+		Node *func_def = func_to_call->func_def;
+		int argc = func_def->func_params.len;
+		if (argc != node->func_args.len) {
+			printf("ERROR: Function '%s' accepts %d arguments, but %d are passed.\n",
+			       func_to_call->func_name, argc, node->func_args.len);
+			exit(1);
+		}
 		// -------
 		//	Populate local variables within the function based on 
 		//	argument names
-		CarrotObj *return_value = NULL;
-		Interpreter local_interpreter = create_interpreter();
-		local_interpreter.parent = context;
-		for (int i = 0; i < arrlen(func_to_call->func_arg_names); i++) {
-			char *argname = func_to_call->func_arg_names[i];
-			CarrotObj *argval = interpreter_visit(
-				&local_interpreter,
-				node->func_args[i]
+		CarrotValue return_value = carrot_null();
+		CarrotValue slots[scope_layout_size(func_def->scope_layout) + 1];
+		Interpreter local_interpreter;
+		interpreter_open_scope(&local_interpreter, context,
+		                       func_def->scope_layout, slots);
+		carrot_gc_push_scope(&local_interpreter);
+		//	The arguments are evaluated in the caller's context, so
+		//	a parameter cannot shadow the argument expressions.
+		//	Parameters occupy the first slots.
+		for (int i = 0; i < argc; i++) {
+			CarrotValue argval = interpreter_visit(
+				context,
+				node->func_args.items[i]
 			);
-			shput(local_interpreter.sym_table, argname, argval);
+			carrot_check_arg(func_to_call, i, argval);
+			if (func_def->scope_layout != NULL)
+				slots[i] = argval;
+			else
+				hmput(local_interpreter.sym_table,
+				      func_def->func_params.items[i]->var_name,
+				      argval);
 		}
 		//      Evaluate the function body (a list of statements)
 		//
-		for (int i = 0; i < arrlen(func_to_call->func_statements); i++) {
-			interpreter_visit(&local_interpreter,
-			                  func_to_call->func_statements[i]);
-			
-			// TODO: check if func_to_call->func_statements[i] node is
-			// a N_RETURN node, and return accordingly
-			Node *stmt = func_to_call->func_statements[i];
+		carrot_profile_enter(func_to_call->func_name);
+		for (int i = 0; i < func_def->func_statements.len; i++) {
+			/* a N_RETURN node is evaluated once and ends the call */
+			Node *stmt = func_def->func_statements.items[i];
+			CarrotValue value = interpreter_visit_statement(&local_interpreter,
+			                                                stmt);
 			if (stmt->type == N_RETURN) {
-				return_value = interpreter_visit(&local_interpreter,
-						                 stmt);
+				return_value = value;
 				break;
 			}
+			carrot_decref(value);
 		}
+		carrot_profile_leave();
 
-		//      End the local variable lifetime, except if it refers to
-		//      the return value object
-		int len = shlen(local_interpreter.sym_table);
-		for (int i = 0; i < len; i++) {
-			/* if return value obj also belongs to local sym_table,
-			 * detach it first so it is not wiped and persists after
-			 * leaving this function. It will still be tracked by
-			 * the global tracker */
-			if (local_interpreter.sym_table[i].value == return_value) {
-				shdel(local_interpreter.sym_table,
-				      local_interpreter.sym_table[i].key);
-			}
-		}
+		//      End the local variable lifetime. The values whose
+		//      last reference was held by the locals are released.
+		carrot_gc_pop_scope();
+		carrot_gc_pop_roots(1);
 		interpreter_free(&local_interpreter);
-		if (return_value==NULL) return carrot_null();
+		carrot_decref(callee);
 		return return_value;
 	}
 }
 
-CarrotObj *interpreter_visit_func_def(Interpreter *context, Node *node) {
-	CarrotObj *function = carrot_obj_allocate();
-	function->func_statements = node->func_statements;
-	strcpy(function->func_name, node->func_name);
-	for (int i = 0; i < arrlen(node->func_params); i++) {
-		arrput(function->func_arg_names, node->func_params[i]->param_name);
-	}
-	shput(context->sym_table, node->func_name, function);
-	return carrot_null();
+static void interpreter_bind(Interpreter *context,
+		             Node *node,
+		             char *var_name,
+		             CarrotValue value) {
+	/* Binds the variable defined or assigned by node in context, which
+	 * takes over the reference of value */
+	if (node->var_resolution == RES_LOCAL)
+		carrot_assign(&context->slots[node->var_slot], value);
+	else
+		carrot_set_var(var_name, context, value);
 }
 
-CarrotObj *interpreter_visit_get_item(Interpreter *context, Node *node) {
-	CarrotObj *the_list = interpreter_visit(context, node->list_node);
-	CarrotObj *the_index = interpreter_visit(context, node->index_node);
-	if (strcmp(the_list->type_str, "list") != 0) {
-		printf("ERROR: %s cannot be indexed\n", the_list->type_str);
-		exit(1);
-	}
-	if (strcmp(the_index->type_str, "int") != 0) {
-		printf("ERROR: Cannot index with type %s\n", the_list->type_str);
-		exit(1);
-	}
+CarrotValue interpreter_visit_func_def(Interpreter *context, Node *node) {
+	CarrotObj *function = carrot_obj_allocate(CARROT_FUNCTION);
+	function->func_def = node;
+	function->func_name = node->func_name;
+	interpreter_bind(context, node, node->func_name, carrot_obj_value(function));
+	return carrot_null();
+}
 
-	return the_list->list_items[the_index->int_val];
-	exit(1);
+CarrotValue interpreter_visit_get_item(Interpreter *context, Node *node) {
+	CarrotValue the_list = interpreter_visit(context, node->list_node);
+	carrot_gc_push_root(the_list);
+	CarrotValue the_index = interpreter_visit(context, node->index_node);
+	carrot_gc_pop_roots(1);
+	CarrotValue item = carrot_incref(carrot_get_item(the_list, the_index));
+	carrot_decref(the_list);
+	carrot_decref(the_index);
+	return item;
 }
 
-CarrotObj *interpreter_visit_if(Interpreter *context, Node *node) {
+CarrotValue interpreter_visit_if(Interpreter *context, Node *node) {
 	int found_true = 0;
-	for (int i = 0; i < arrlen(node->conditions); i++) {
-		if (interpreter_visit(context, node->conditions[i])->bool_val) {
-			interpreter_visit(context, node->if_blocks[i]);
+	for (int i = 0; i < node->conditions.len; i++) {
+		CarrotValue condition = interpreter_visit(context,
+		                                          node->conditions.items[i]);
+		int is_true = carrot_is_true(condition);
+		carrot_decref(condition);
+		if (is_true) {
+			interpreter_visit(context, node->if_blocks.items[i]);
 			found_true = 1;
 			break;
 		}
@@ -213,71 +292,132 @@ CarrotObj *interpreter_visit_if(Interpreter *context, Node *node) {
 	return carrot_null();
 }
 
-CarrotObj *interpreter_visit_iter(Interpreter *context, Node *node) {
-	CarrotObj *iterable = interpreter_visit(context, node->iterable);
-	int iterable_len = arrlen(iterable->list_items);
-	char *loop_iterator_var_name = node->loop_iterator_var_name;
-	char *loop_index_var_name = node->loop_index_var_name;
-	Interpreter local_interpreter = create_interpreter();
-	local_interpreter.parent = context;
-
-	for (int i = 0; i < iterable_len; i++) {
-		shput(local_interpreter.sym_table,
-		      loop_iterator_var_name,
-		      iterable->list_items[i]);
+static void interpreter_run_loop_body(Interpreter *local_interpreter,
+		                      Node *node,
+		                      CarrotValue item,
+		                      int idx) {
+	/* item is borrowed from the iterable */
+	if (node->scope_layout != NULL) {
+		carrot_assign(&local_interpreter->slots[node->loop_iterator_slot],
+		              carrot_incref(item));
 		if (node->loop_with_index)
-			shput(local_interpreter.sym_table,
-			      loop_index_var_name,
-			      carrot_int(i));
-		for (int j = 0; j < arrlen(node->loop_statements); j++)
-			interpreter_visit(&local_interpreter,
-				          node->loop_statements[j]);
-	}
-	/* TODO: free local variables */
+			carrot_assign(&local_interpreter->slots[node->loop_index_slot],
+			              carrot_int(idx));
+	} else {
+		carrot_set_var(node->loop_iterator_var_name,
+		               local_interpreter,
+		               carrot_incref(item));
+		if (node->loop_with_index)
+			carrot_set_var(node->loop_index_var_name,
+			               local_interpreter,
+			               carrot_int(idx));
+	}
+	for (int j = 0; j < node->loop_statements.len; j++) {
+		carrot_decref(interpreter_visit_statement(local_interpreter,
+		                                          node->loop_statements.items[j]));
+	}
+}
+
+static int interpreter_range_call(Interpreter *context,
+		                  Node *node,
+		                  int *start,
+		                  int *stop,
+		                  int *step) {
+	/* Evaluates the bounds of a range(...) iterable without creating
+	 * the range. Returns 0 if node is not a call of the builtin range,
+	 * which is then evaluated as usual. */
+	if (node->type != N_FUNC_CALL || node->callee->type != N_VAR_ACCESS)
+		return 0;
+	CarrotValue callee = interpreter_visit(context, node->callee);
+	int is_range = carrot_is_range_func(callee);
+	carrot_decref(callee);
+	if (!is_range)
+		return 0;
+
+	/* the arguments are checked to be ints, nothing to release */
+	int argc = node->func_args.len;
+	CarrotValue args[argc + 1];
+	for (int i = 0; i < argc; i++) {
+		args[i] = interpreter_visit(context, node->func_args.items[i]);
+	}
+	carrot_range_args(args, argc, start, stop, step);
+	return 1;
+}
+
+CarrotValue interpreter_visit_iter(Interpreter *context, Node *node) {
+	/* Loops over a range are counted, the induction variable is never
+	 * boxed */
+	int start, stop, step;
+	int counted = interpreter_range_call(context, node->iterable,
+	                                     &start, &stop, &step);
+	CarrotValue iterable = carrot_null();
+	CarrotIterator iter;
+	if (!counted) {
+		iterable = interpreter_visit(context, node->iterable);
+		carrot_iter_init(&iter, iterable);
+		if (iterable.type == CARROT_RANGE) {
+			counted = 1;
+			start = iterable.obj->range_start;
+			stop = iterable.obj->range_stop;
+			step = iterable.obj->range_step;
+		}
+	}
+
+	CarrotValue slots[scope_layout_size(node->scope_layout) + 1];
+	Interpreter local_interpreter;
+	interpreter_open_scope(&local_interpreter, context,
+	                       node->scope_layout, slots);
+	carrot_gc_push_scope(&local_interpreter);
+	carrot_gc_push_root(iterable);
+
+	if (counted) {
+		int cnt = carrot_range_count(start, stop, step);
+		int i = start;
+		for (int idx = 0; idx < cnt; idx++) {
+			interpreter_run_loop_body(&local_interpreter, node,
+			                          carrot_int(i), idx);
+			/* stepping past the last item could overflow */
+			if (idx + 1 < cnt) i += step;
+		}
+	} else {
+		CarrotValue item;
+		for (int idx = 0; carrot_iter_next(&iter, &item); idx++) {
+			interpreter_run_loop_body(&local_interpreter, node,
+			                          item, idx);
+		}
+	}
+	carrot_gc_pop_roots(1);
+	carrot_gc_pop_scope();
 	interpreter_free(&local_interpreter);
+	carrot_decref(iterable);
 	return carrot_null();
 }
 
-CarrotObj *interpreter_visit_return(Interpreter *context, Node *node) {
+CarrotValue interpreter_visit_return(Interpreter *context, Node *node) {
 	return interpreter_visit(context, node->return_value);
 }
 
-CarrotObj *interpreter_visit_statements(Interpreter *context, Node *node) {
-	int list_item_count = arrlen(node->list_items);
-
-	CarrotObj **list_items = NULL;
-	for (int i = 0; i < list_item_count; i++) {
-		CarrotObj *item = interpreter_visit(context, node->list_items[i]);
-		arrput(list_items, item);
+CarrotValue interpreter_visit_statements(Interpreter *context, Node *node) {
+	/* Statement results are discarded, only the last one is kept. The
+	 * previous one is dropped before the safepoint of the next
+	 * statement, as it is not rooted. */
+	CarrotValue result = carrot_null();
+	for (int i = 0; i < node->statements.len; i++) {
+		carrot_decref(result);
+		result = interpreter_visit_statement(context, node->statements.items[i]);
 	}
-
-	return carrot_list(list_items);
+	return result;
 }
 
-CarrotObj *interpreter_visit_unop(Interpreter *context, Node *node) {
-	CarrotObj *right = interpreter_visit(context, node->right);
-
-	if (strcmp(node->op_str, "!") == 0) {
-		if (strcmp(right->type_str, "bool") == 0) {
-			return carrot_bool(!right->bool_val);
-		}
-	} else if (strcmp(node->op_str, "-") == 0) {
-		if (strcmp(right->type_str, "int") == 0) {
-			return carrot_int(-right->int_val);
-		} else if (strcmp(right->type_str, "float") == 0) {
-			return carrot_float(-right->float_val);
-		}
-	} else if (strcmp(node->op_str, "+") == 0) {
-		return right;
-	} 
+CarrotValue interpreter_visit_unop(Interpreter *context, Node *node) {
+	CarrotValue right = interpreter_visit(context, node->right);
 
-	printf("ERROR: Cannot perform unary %s on %s\n", node->op_str, right->type_str);
-	exit(1);
+	return carrot_unop(node->op, right);
 }
 
-CarrotObj *interpreter_visit_value(Interpreter *context, Node *node) {
+CarrotValue interpreter_visit_value(Interpreter *context, Node *node) {
 	if (node->var_type == DT_STR) {
-		return carrot_str(node->value_token.text);
+		return carrot_str_const(node->str_val);
 	} else if (node->var_type == DT_INT) {
 		return carrot_int(node->int_val);
 	} else if (node->var_type == DT_FLOAT) {
@@ -285,448 +425,497 @@ CarrotObj *interpreter_visit_value(Interpreter *context, Node *node) {
 	} else if (node->var_type == DT_BOOL) {
 		return carrot_bool(node->bool_val);
 	} else if (node->var_type == DT_NULL) {
-		return carrot_null(node->bool_val);
+		return carrot_null();
 	} else if (node->var_type == DT_LIST) {
-		CarrotObj **list_items = NULL;
-		for (int i = 0; i < arrlen(node->list_items); i++) {
-			arrput(list_items,
-			       interpreter_visit(context, node->list_items[i]));
+		CarrotValue *list_items = NULL;
+		for (int i = 0; i < node->list_items.len; i++) {
+			CarrotValue item = interpreter_visit(context,
+			                                     node->list_items.items[i]);
+			carrot_gc_push_root(item);
+			arrput(list_items, item);
 		}
+		carrot_gc_pop_roots(arrlen(list_items));
 		return carrot_list(list_items);
 	} else {
-		printf("The data type for \"%s\" is not supported yet", node->value_token.text);
+		printf("The data type %d is not supported yet", node->var_type);
 		exit(1);
 	}
 
 }
 
-CarrotObj *interpreter_visit_var_access(Interpreter *context, Node *node) {
-	char *var_name = node->var_name;
-	CarrotObj *obj = carrot_get_var(var_name, context);
-
-	if (obj == NULL) {
-		char msg[255];
-		sprintf(msg,
-		        "You are trying to access variable \"%s\", while it is undefined. "
-			"Have you defined it before?",
-			var_name);
-		carrot_log_error(msg, "idklol", -1);
-		exit(1);
+CarrotValue interpreter_visit_var_access(Interpreter *context, Node *node) {
+	CarrotValue value = carrot_undefined();
+	if (node->var_resolution == RES_LOCAL) {
+		Interpreter *scope = context;
+		for (int i = 0; i < node->var_depth; i++) scope = scope->parent;
+		value = scope->slots[node->var_slot];
+	} else if (node->var_resolution == RES_GLOBAL) {
+		value = context->globals->slots[node->var_slot];
 	}
 
-	return obj;
+	/* Unresolved, or the slot is not bound yet */
+	if (value.type == CARROT_UNDEFINED)
+		value = carrot_lookup_var(node->var_name, context);
+	return carrot_incref(value);
 }
 
-CarrotObj *interpreter_visit_var_assign(Interpreter *context, Node *node) {
-	CarrotObj *existing_var_content = shget(context->sym_table, node->var_name);
-	if (existing_var_content != NULL) {
-		/* remove existing_var_content from context's local symbol table and
-		 * global tracker */
-		shdel(context->sym_table, node->var_name);
-
-		/* TODO Remove the existing variable content itself */
-		// shdel(CARROT_TRACKING_ARR, existing_var_content->hash);
-	}
-	CarrotObj *var_content = interpreter_visit(context, node->var_node);
-	shput(context->sym_table, node->var_name, var_content);
+CarrotValue interpreter_visit_var_assign(Interpreter *context, Node *node) {
+	CarrotValue var_content = interpreter_visit(context, node->var_node);
+	interpreter_bind(context, node, node->var_name, carrot_incref(var_content));
 	return var_content;
 }
 
-CarrotObj *interpreter_visit_var_def(Interpreter *context, Node *node) {
-	if (shget(context->sym_table, node->var_name) != NULL) {
+CarrotValue interpreter_visit_var_def(Interpreter *context, Node *node) {
+	int defined;
+	if (node->var_resolution == RES_LOCAL)
+		defined = context->slots[node->var_slot].type != CARROT_UNDEFINED;
+	else
+		defined = carrot_get_local_var(node->var_name, context) != NULL;
+	if (defined) {
 		printf("ERROR: variable redefinition in the same scope: %s\n", 
 		       node->var_name);
 		exit(1);
 	}
-	CarrotObj *var_content = interpreter_visit(context, node->var_node);
-	shput(context->sym_table, node->var_name, var_content);
+	CarrotValue var_content = interpreter_visit(context, node->var_node);
+	interpreter_bind(context, node, node->var_name, carrot_incref(var_content));
 
 	return var_content;
 }
 
-CarrotObj *__int_add(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->int_val + other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->int_val + other->float_val);
-	}
-	printf("ERROR: Cannot perform addition on %s and %s\n", self->type_str, other->type_str);
+/*===========================================================================
+ * Operators
+ *===========================================================================*/
+
+/* Defines the handler of an operator for one pair of operand types.
+ * The result constructor decides the result type, e.g. float + int
+ * yields an int. */
+#define CARROT_DEFINE_BINOP(name, make, left_val, op, right_val)         \
+	static CarrotValue name(CarrotValue left, CarrotValue right) {   \
+		return make(left.left_val op right.right_val);           \
+	}
+
+#define CARROT_DEFINE_NUMERIC_BINOPS(prefix, arith, div, left_val, right_val)      \
+	CARROT_DEFINE_BINOP(prefix##_add, arith, left_val, +, right_val)                \
+	CARROT_DEFINE_BINOP(prefix##_subtract, arith, left_val, -, right_val)           \
+	CARROT_DEFINE_BINOP(prefix##_mult, arith, left_val, *, right_val)               \
+	CARROT_DEFINE_BINOP(prefix##_div, div, left_val, /, right_val)                  \
+	CARROT_DEFINE_BINOP(prefix##_ee, carrot_bool, left_val, ==, right_val)          \
+	CARROT_DEFINE_BINOP(prefix##_ne, carrot_bool, left_val, !=, right_val)          \
+	CARROT_DEFINE_BINOP(prefix##_gt, carrot_bool, left_val, >, right_val)           \
+	CARROT_DEFINE_BINOP(prefix##_lt, carrot_bool, left_val, <, right_val)           \
+	CARROT_DEFINE_BINOP(prefix##_ge, carrot_bool, left_val, >=, right_val)          \
+	CARROT_DEFINE_BINOP(prefix##_le, carrot_bool, left_val, <=, right_val)
+
+CARROT_DEFINE_NUMERIC_BINOPS(int_int, carrot_int, carrot_int, int_val, int_val)
+CARROT_DEFINE_NUMERIC_BINOPS(int_float, carrot_float, carrot_float, int_val, float_val)
+CARROT_DEFINE_NUMERIC_BINOPS(float_int, carrot_int, carrot_float, float_val, int_val)
+CARROT_DEFINE_NUMERIC_BINOPS(float_float, carrot_float, carrot_float, float_val, float_val)
+
+CARROT_DEFINE_BINOP(bool_bool_and, carrot_bool, bool_val, &&, bool_val)
+CARROT_DEFINE_BINOP(bool_bool_or, carrot_bool, bool_val, ||, bool_val)
+
+static CarrotValue str_str_add(CarrotValue left, CarrotValue right) {
+	sds dup = sdsdup(left.obj->str_val);
+	sds cat = sdscatsds(dup, right.obj->str_val); // dup + right.obj->str_val; dup IS INVALIDATED AND SHOULD NOT BE USED
+
+	CarrotValue carrot_obj = carrot_str(cat);
+	sdsfree(cat);		// free the cat
+
+	return carrot_obj;
+}
+
+static CarrotValue str_str_ee(CarrotValue left, CarrotValue right) {
+	return carrot_bool(sdscmp(left.obj->str_val, right.obj->str_val) == 0);
+}
+
+static CarrotValue str_str_ne(CarrotValue left, CarrotValue right) {
+	return carrot_bool(sdscmp(left.obj->str_val, right.obj->str_val) != 0);
+}
+
+#define CARROT_NUMERIC_BINOPS(prefix)                   \
+	{                                               \
+		[OPR_ADD] = prefix##_add,               \
+		[OPR_SUBTRACT] = prefix##_subtract,     \
+		[OPR_MULT] = prefix##_mult,             \
+		[OPR_DIV] = prefix##_div,               \
+		[OPR_EE] = prefix##_ee,                 \
+		[OPR_NE] = prefix##_ne,                 \
+		[OPR_GT] = prefix##_gt,                 \
+		[OPR_LT] = prefix##_lt,                 \
+		[OPR_GE] = prefix##_ge,                 \
+		[OPR_LE] = prefix##_le,                 \
+	}
+
+const carrot_binop_t CARROT_BINOPS[CARROT_DTYPE_NUM][CARROT_DTYPE_NUM][BINARY_OPR_NUM] = {
+	[CARROT_INT] = {
+		[CARROT_INT] = CARROT_NUMERIC_BINOPS(int_int),
+		[CARROT_FLOAT] = CARROT_NUMERIC_BINOPS(int_float),
+	},
+	[CARROT_FLOAT] = {
+		[CARROT_INT] = CARROT_NUMERIC_BINOPS(float_int),
+		[CARROT_FLOAT] = CARROT_NUMERIC_BINOPS(float_float),
+	},
+	[CARROT_BOOL] = {
+		[CARROT_BOOL] = {
+			[OPR_AND] = bool_bool_and,
+			[OPR_OR] = bool_bool_or,
+		},
+	},
+	[CARROT_STR] = {
+		[CARROT_STR] = {
+			[OPR_ADD] = str_str_add,
+			[OPR_EE] = str_str_ee,
+			[OPR_NE] = str_str_ne,
+		},
+	},
+};
+
+void carrot_binop_error(operator_t op, CarrotValue left, CarrotValue right) {
+	printf("ERROR: operator %s is not defined for type %s and %s\n",
+	       operator_to_str(op), carrot_type_str(left), carrot_type_str(right));
 	exit(1);
 }
 
-CarrotObj *__int_subtract(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->int_val - other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->int_val - other->float_val);
+void carrot_check_arg(CarrotObj *function, int i, CarrotValue arg) {
+	/* The type checker relies on the declared parameter types */
+	Node *param = function->func_def->func_params.items[i];
+	data_type_t type = param->var_decl_type;
+	int matches;
+	switch (arg.type) {
+		case CARROT_STR:      matches = type == DT_STR; break;
+		case CARROT_INT:      matches = type == DT_INT; break;
+		case CARROT_FLOAT:    matches = type == DT_FLOAT; break;
+		case CARROT_BOOL:     matches = type == DT_BOOL; break;
+		case CARROT_LIST:
+		case CARROT_RANGE:    matches = type == DT_LIST; break;
+		case CARROT_NULL:     matches = type == DT_NULL; break;
+		case CARROT_FUNCTION: matches = type == DT_FUNC; break;
+		default:              matches = 0;
+	}
+	if (!matches && type != DT_UNKNOWN) {
+		printf("ERROR: Function '%s' expects %s for parameter '%s', but %s is passed.\n",
+		       function->func_name, param->var_type_str, param->var_name,
+		       carrot_type_str(arg));
+		exit(1);
 	}
-	printf("ERROR: Cannot perform subtraction on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
 }
 
-CarrotObj *__int_mult(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->int_val * other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->int_val * other->float_val);
+CarrotValue carrot_unop(operator_t op, CarrotValue right) {
+	if (op == OPR_NOT) {
+		if (right.type == CARROT_BOOL) {
+			return carrot_bool(!right.bool_val);
+		}
+	} else if (op == OPR_NEGATE) {
+		if (right.type == CARROT_INT) {
+			return carrot_int(-right.int_val);
+		} else if (right.type == CARROT_FLOAT) {
+			return carrot_float(-right.float_val);
+		}
+	} else if (op == OPR_PLUS) {
+		return right;
 	}
-	printf("ERROR: Cannot perform multiplication on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
-}
 
-CarrotObj *__int_div(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->int_val / other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float((float)self->int_val / other->float_val);
-	}
-	printf("ERROR: Cannot perform division on %s and %s\n", self->type_str, other->type_str);
+	printf("ERROR: Cannot perform unary %s on %s\n", operator_to_str(op), carrot_type_str(right));
 	exit(1);
 }
 
-CarrotObj *__int_ee(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->int_val == other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->int_val == other->float_val);
-	}
-	printf("ERROR: Cannot perform \"equal to\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
-}
+CarrotObj *carrot_obj_allocate(carrot_dtype_t type) {
+	/* The caller owns the first reference */
+	CarrotObj *obj = carrot_pool_calloc(sizeof(CarrotObj));
+	obj->type = type;
+	obj->refcount = 1;
+	carrot_stats_count_obj(type);
 
-CarrotObj *__int_ne(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->int_val != other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->int_val != other->float_val);
-	}
-	printf("ERROR: Cannot perform \"not equal to\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	obj->next = CARROT_HEAP_OBJS;
+	if (CARROT_HEAP_OBJS != NULL) CARROT_HEAP_OBJS->prev = obj;
+	CARROT_HEAP_OBJS = obj;
+	carrot_gc_account(sizeof(CarrotObj));
+	return obj;
 }
 
-CarrotObj *__int_gt(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->int_val > other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->int_val > other->float_val);
-	}
-	printf("ERROR: Cannot perform \">\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_obj_value(CarrotObj *obj) {
+	CarrotValue value;
+	value.type = obj->type;
+	value.obj = obj;
+	return value;
 }
 
-CarrotObj *__int_lt(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->int_val < other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->int_val < other->float_val);
-	}
-	printf("ERROR: Cannot perform \"<\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_noop() {
+	return carrot_null();
 }
 
-CarrotObj *__int_ge(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->int_val >= other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->int_val >= other->float_val);
-	}
-	printf("ERROR: Cannot perform \">=\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_null() {
+	CarrotValue value;
+	value.type = CARROT_NULL;
+	value.obj = NULL;
+	return value;
 }
 
-CarrotObj *__int_le(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->int_val <= other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->int_val <= other->float_val);
-	}
-	printf("ERROR: Cannot perform \"<=\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_undefined() {
+	CarrotValue value;
+	value.type = CARROT_UNDEFINED;
+	value.obj = NULL;
+	return value;
 }
 
-CarrotObj *__float_add(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->float_val + (int) other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->float_val + other->float_val);
+CarrotValue *carrot_get_local_var(char *var_name, Interpreter *context) {
+	/* look up the variable bound in context itself, NULL if there is
+	 * none. Like every variable name, var_name must be interned. */
+	if (context->layout != NULL) {
+		ptrdiff_t idx = hmgeti(context->layout->slots, var_name);
+		if (idx >= 0) {
+			CarrotValue *value = &context->slots[context->layout->slots[idx].value];
+			if (value->type != CARROT_UNDEFINED) return value;
+		}
 	}
 
-	printf("ERROR: Cannot perform addition on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	ptrdiff_t idx = hmgeti(context->sym_table, var_name);
+	if (idx >= 0)
+		return &context->sym_table[idx].value;
+	return NULL;
 }
 
-CarrotObj *__float_subtract(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->float_val - (float) other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->float_val - other->float_val);
+CarrotValue *carrot_get_var(char *var_name, Interpreter *context) {
+	/* look up the variable based on name. If it is not found 
+	 * in the context's sym_table, then recursicely look up
+	 * on context's parent interpreter */
+	CarrotValue *value = carrot_get_local_var(var_name, context);
+	if (value != NULL)
+		return value;
+
+	if (context->parent != NULL) {
+		return carrot_get_var(var_name, context->parent);
 	}
 
-	printf("ERROR: Cannot perform subtraction on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	return NULL;
 }
 
-CarrotObj *__float_mult(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_int(self->float_val * (float) other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->float_val * other->float_val);
+CarrotValue carrot_lookup_var(char *var_name, Interpreter *context) {
+	/* Same as carrot_get_var(), but a missing variable is an error */
+	CarrotValue *value = carrot_get_var(var_name, context);
+
+	if (value == NULL) {
+		char msg[255];
+		snprintf(msg, 255,
+		         "You are trying to access variable \"%s\", while it is undefined. "
+		         "Have you defined it before?",
+		         var_name);
+		carrot_log_error(msg, "idklol", -1);
+		exit(1);
 	}
 
-	printf("ERROR: Cannot perform multiplication on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	return *value;
 }
 
-CarrotObj *__float_div(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_float(self->float_val / (float)other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_float(self->float_val / other->float_val);
+void carrot_set_var(char *var_name, Interpreter *context, CarrotValue value) {
+	/* Binds var_name in context, in its slot if it has one. The variable
+	 * takes over the reference of value. */
+	if (context->layout != NULL) {
+		ptrdiff_t idx = hmgeti(context->layout->slots, var_name);
+		if (idx >= 0) {
+			carrot_assign(&context->slots[context->layout->slots[idx].value],
+			              value);
+			return;
+		}
 	}
-
-	printf("ERROR: Cannot perform division on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	ptrdiff_t idx = hmgeti(context->sym_table, var_name);
+	if (idx >= 0)
+		carrot_assign(&context->sym_table[idx].value, value);
+	else
+		hmput(context->sym_table, var_name, value);
 }
 
-CarrotObj *__float_ee(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->float_val == other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->float_val == other->float_val);
-	}
-	printf("ERROR: Cannot perform \"==\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_bool(int bool_val) {
+	CarrotValue value;
+	value.type = CARROT_BOOL;
+	value.bool_val = bool_val;
+	return value;
 }
 
-CarrotObj *__float_ne(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->float_val != other->float_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->float_val != other->float_val);
-	}
-	printf("ERROR: Cannot perform \"!=\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_int(int int_val) {
+	CarrotValue value;
+	value.type = CARROT_INT;
+	value.int_val = int_val;
+	return value;
 }
 
-CarrotObj *__float_gt(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->float_val > other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->float_val > other->float_val);
-	}
-	printf("ERROR: Cannot perform \">\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_list(CarrotValue *list_items) {
+	/* The list takes over the references of its items */
+	CarrotObj *obj = carrot_obj_allocate(CARROT_LIST);
+	obj->list_items = list_items;
+	carrot_gc_account(arrcap(list_items) * sizeof(CarrotValue));
+	return carrot_obj_value(obj);
 }
 
-CarrotObj *__float_lt(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->float_val < other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->float_val < other->float_val);
-	}
-	printf("ERROR: Cannot perform \"<\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+CarrotValue carrot_range(int start, int stop, int step) {
+	CarrotObj *obj = carrot_obj_allocate(CARROT_RANGE);
+	obj->range_start = start;
+	obj->range_stop = stop;
+	obj->range_step = step;
+	return carrot_obj_value(obj);
 }
 
-CarrotObj *__float_ge(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->float_val >= other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->float_val >= other->float_val);
-	}
-	printf("ERROR: Cannot perform \">=\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+int carrot_range_len(CarrotObj *range) {
+	return carrot_range_count(range->range_start, range->range_stop,
+	                          range->range_step);
 }
 
-CarrotObj *__float_le(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "int") == 0) {
-		return carrot_bool(self->float_val <= other->int_val);
-	} else if (strcmp(other->type_str, "float") == 0) {
-		return carrot_bool(self->float_val <= other->float_val);
+int carrot_range_count(int start, int stop, int step) {
+	/* computed in long long so that huge bounds cannot overflow */
+	long long span = (long long) stop - start;
+	long long stride = step;
+	if (stride < 0) {
+		span = -span;
+		stride = -stride;
 	}
-	printf("ERROR: Cannot perform \"<=\" comparison on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	if (span <= 0) return 0;
+	return (span + stride - 1) / stride;
 }
 
-CarrotObj *__bool_and(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "bool") == 0) {
-		return carrot_bool(self->bool_val && other->bool_val);
-	} 
-	printf("ERROR: Cannot use \"&&\" on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+static int carrot_list_iter_next(CarrotIterator *iter, CarrotValue *item) {
+	CarrotObj *list = iter->iterable.obj;
+	if (iter->idx >= arrlen(list->list_items)) return 0;
+	*item = list->list_items[iter->idx++];
+	return 1;
 }
 
-CarrotObj *__bool_or(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "bool") == 0) {
-		return carrot_bool(self->bool_val || other->bool_val);
-	} 
-	printf("ERROR: Cannot use \"||\" on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+static int carrot_range_iter_next(CarrotIterator *iter, CarrotValue *item) {
+	CarrotObj *range = iter->iterable.obj;
+	if (iter->idx >= carrot_range_len(range)) return 0;
+	*item = carrot_int(range->range_start + iter->idx++ * range->range_step);
+	return 1;
 }
 
-CarrotObj *__str_add(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "str") == 0) {
-		sds dup = sdsdup(self->str_val);
-		sds cat = sdscatsds(dup, other->str_val); // dup + other->str_val; dup IS INVALIDATED AND SHOULD NOT BE USED
-		
-		CarrotObj* carrot_obj = carrot_str(cat);
-		sdsfree(cat);		// free the cat
-		
-		return carrot_obj;
+void carrot_iter_init(CarrotIterator *iter, CarrotValue iterable) {
+	if (CARROT_TYPES[iterable.type].iter_next == NULL) {
+		printf("ERROR: %s is not iterable\n", carrot_type_str(iterable));
+		exit(1);
 	}
-	printf("ERROR: Cannot perform addition on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	iter->iterable = iterable;
+	iter->idx = 0;
 }
 
-CarrotObj *__str_ee(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "str") == 0) {
-		int ee = sdscmp(self->str_val, other->str_val) == 0;
-		return carrot_bool(ee);
+CarrotValue carrot_get_item(CarrotValue the_list, CarrotValue the_index) {
+	if (the_list.type != CARROT_LIST && the_list.type != CARROT_RANGE) {
+		printf("ERROR: %s cannot be indexed\n", carrot_type_str(the_list));
+		exit(1);
+	}
+	if (the_index.type != CARROT_INT) {
+		printf("ERROR: Cannot index with type %s\n",
+		       carrot_type_str(the_index));
+		exit(1);
 	}
-	printf("ERROR: Cannot use \"equal to\" on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
-}
 
-CarrotObj *__str_ne(CarrotObj *self, CarrotObj *other) {
-	if (strcmp(other->type_str, "str") == 0) {
-		int ne = sdscmp(self->str_val, other->str_val) != 0;
-		return carrot_bool(ne);
+	CarrotObj *list = the_list.obj;
+	int len = list->type == CARROT_RANGE ? carrot_range_len(list)
+	                                     : arrlen(list->list_items);
+	if (the_index.int_val < 0 || the_index.int_val >= len) {
+		printf("ERROR: list index %d is out of range\n", the_index.int_val);
+		exit(1);
 	}
-	printf("ERROR: Cannot use \"not equal to\" on %s and %s\n", self->type_str, other->type_str);
-	exit(1);
+	if (list->type == CARROT_RANGE)
+		return carrot_int(list->range_start +
+		                  the_index.int_val * list->range_step);
+	return list->list_items[the_index.int_val];
 }
 
-CarrotObj *carrot_obj_allocate() {
-	CarrotObj *obj = calloc(1, sizeof(CarrotObj));
-
-	char *hash = calloc(1, 64);
-	sprintf(hash, "%p", (void *) obj);
-	obj->hash = hash;
-	shput(CARROT_TRACKING_ARR, hash, obj);
-	return obj;
+CarrotValue carrot_float(float float_val) {
+	CarrotValue value;
+	value.type = CARROT_FLOAT;
+	value.float_val = float_val;
+	return value;
 }
 
-CarrotObj *carrot_noop() {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_NULL;
-	return obj;
+CarrotValue carrot_str(char *str_val) {
+	CarrotObj *obj = carrot_obj_allocate(CARROT_STR);
+	obj->str_val = sdsnew(str_val);
+	carrot_gc_account(sdsalloc(obj->str_val));
+	return carrot_obj_value(obj);
 }
 
-CarrotObj *carrot_null() {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_NULL;
-	obj->type_str = sdsnew("null");
-	obj->repr = sdsnew("null");
-	return obj;
-}
+CarrotValue carrot_str_const(char *str_val) {
+	/* Strings never change, so every evaluation of a string literal
+	 * can share one object. It is made the first time and lives until
+	 * carrot_finalize(), the table keeping a reference to it. str_val
+	 * must be interned. */
+	ptrdiff_t idx = hmgeti(CARROT_STR_CONSTS, str_val);
+	if (idx >= 0)
+		return carrot_incref(carrot_obj_value(CARROT_STR_CONSTS[idx].value));
 
-CarrotObj *carrot_get_var(char *var_name, Interpreter *context) {
-	/* look up the variable based on name. If it is not found 
-	 * in the context's sym_table, then recursicely look up
-	 * on context's parent interpreter */
-	CarrotObj *obj = shget(context->sym_table, var_name);
-	if (obj != NULL)
-		return obj;
+	CarrotValue value = carrot_str(str_val);
+	hmput(CARROT_STR_CONSTS, str_val, value.obj);
+	return carrot_incref(value);
+}
 
-	if (obj == NULL && context->parent != NULL) {
-		return carrot_get_var(var_name, context->parent);
+static void carrot_mark_str_consts(void *data) {
+	(void) data;
+	for (int i = 0; i < hmlen(CARROT_STR_CONSTS); i++) {
+		carrot_gc_mark_value(carrot_obj_value(CARROT_STR_CONSTS[i].value));
 	}
-
-	return NULL;
 }
 
-CarrotObj *carrot_bool(int bool_val) {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_BOOL;
-	obj->bool_val = bool_val;
-	obj->type_str = sdsnew("bool");
-	obj->repr = sdscatprintf(sdsempty(),
-			         "%s",
-				 bool_val == 1 ? "true" : "false");
-	obj->__and = __bool_and;
-	obj->__or = __bool_or;
-	return obj;
+int carrot_is_true(CarrotValue value) {
+	/* Only booleans can be true, conditions of any other type are
+	 * treated as false */
+	return value.type == CARROT_BOOL && value.bool_val;
 }
 
-CarrotObj *carrot_int(int int_val) {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_INT;
-	obj->int_val = int_val;
-	obj->type_str = sdsnew("int");
-	obj->repr = sdscatprintf(sdsempty(), "%d", int_val);
-	obj->__add = __int_add;
-	obj->__subtract = __int_subtract;
-	obj->__mult = __int_mult;
-	obj->__div = __int_div;
-	obj->__ee = __int_ee;
-	obj->__ne = __int_ne;
-	obj->__ge = __int_ge;
-	obj->__le = __int_le;
-	obj->__gt = __int_gt;
-	obj->__lt = __int_lt;
-	return obj;
-}
+char *carrot_obj_repr(CarrotObj *obj) {
+	/* The representation is only built when something asks for it.
+	 * Lists, ranges and their items never change, so it is cached in
+	 * the object until the object is collected. */
+	if (obj->type == CARROT_STR) return obj->str_val;
+	if (obj->type == CARROT_FUNCTION) return "function";
+	if (obj->repr != NULL) return obj->repr;
 
-CarrotObj *carrot_list(CarrotObj **list_items) {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_LIST;
-	obj->list_items = list_items;
-	obj->type_str = sdsnew("list");
 	sds repr = sdsnew("[");
-	for (int i = 0; i < arrlen(list_items); i++) {
-		if (list_items[i]->type == CARROT_STR) {
+	CarrotIterator iter;
+	CarrotValue item;
+	carrot_iter_init(&iter, carrot_obj_value(obj));
+	while (carrot_iter_next(&iter, &item)) {
+		if (iter.idx > 1)
+			repr = sdscat(repr, ", ");
+
+		if (item.type == CARROT_STR) {
 			repr = sdscat(repr, "\"");
-			repr = sdscatsds(repr, list_items[i]->repr);
+			repr = carrot_repr_cat(repr, item);
 			repr = sdscat(repr, "\"");
 		} else {
-			repr = sdscatsds(repr, list_items[i]->repr);
+			repr = carrot_repr_cat(repr, item);
 		}
-
-		if (i < arrlen(list_items) - 1)
-			repr = sdscat(repr, ", ");
 	}
 	repr = sdscat(repr, "]");
 	obj->repr = repr;
-	return obj;
+	carrot_gc_account(sdsalloc(repr));
+	return repr;
 }
 
-CarrotObj *carrot_float(float float_val) {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_FLOAT;
-	obj->float_val = float_val;
-	obj->type_str = sdsnew("float");
-	obj->repr = sdscatprintf(sdsempty(), "%f", float_val);
-	obj->__add = __float_add;
-	obj->__subtract = __float_subtract;
-	obj->__mult = __float_mult;
-	obj->__div = __float_div;
-	obj->__ee = __float_ee;
-	obj->__ne = __float_ne;
-	obj->__ge = __float_ge;
-	obj->__le = __float_le;
-	obj->__gt = __float_gt;
-	obj->__lt = __float_lt;
-	return obj;
+sds carrot_repr_cat(sds s, CarrotValue value) {
+	/* Appends the representation of value to s */
+	switch (value.type) {
+		case CARROT_INT:
+			return sdscatprintf(s, "%d", value.int_val);
+		case CARROT_FLOAT:
+			return sdscatprintf(s, "%f", value.float_val);
+		case CARROT_BOOL:
+			return sdscat(s, value.bool_val == 1 ? "true" : "false");
+		case CARROT_NULL:
+			return sdscat(s, "null");
+		default:
+			return sdscat(s, carrot_obj_repr(value.obj));
+	}
 }
 
-CarrotObj *carrot_str(char *str_val) {
-	CarrotObj *obj = carrot_obj_allocate();
-	obj->type = CARROT_STR;
-	obj->str_val = sdsnew(str_val);
-	obj->type_str = sdsnew("str");
-	obj->repr = sdsnew(str_val);
-	obj->__add = __str_add;
-	obj->__ee = __str_ee;
-	obj->__ne = __str_ne;
-	return obj;
+char *carrot_type_str(CarrotValue value) {
+	return CARROT_TYPES[value.type].name;
 }
 
-CarrotObj *carrot_eval(Interpreter *interpreter, char *source) {
+CarrotValue carrot_eval(Interpreter *interpreter, char *source) {
 	Parser parser;
 	parser_init(&parser, source);
 	Node *n = parser_parse(&parser);
 
-	CarrotObj *res = interpreter_interpret(interpreter, n);
+	CarrotValue res = interpreter_interpret(interpreter, n);
 
 	free_node(n);
 	return res;
@@ -735,46 +924,98 @@ CarrotObj *carrot_eval(Interpreter *interpreter, char *source) {
 void carrot_finalize() {
 	/* Frees remaining CarrotObj's in heap.
 	 * Call this in the very end of main function */
-	int len = shlen(CARROT_TRACKING_ARR);
-	for (int i = 0; i < len; i++) {
-		CarrotObj *obj = CARROT_TRACKING_ARR[i].value;
-		shdel(CARROT_TRACKING_ARR, obj->hash);
-		carrot_free(obj);
+	while (CARROT_HEAP_OBJS != NULL) {
+		carrot_free(CARROT_HEAP_OBJS);
+	}
+
+	hmfree(CARROT_STR_CONSTS);
+	carrot_gc_finalize();
+	carrot_intern_finalize();
+	carrot_pool_finalize();
+}
+
+size_t carrot_obj_size(CarrotObj *obj) {
+	/* Bytes charged to the garbage collector for obj, must match the
+	 * carrot_gc_account() calls made while building it */
+	size_t size = sizeof(CarrotObj);
+	if (obj->type == CARROT_STR) {
+		size += sdsalloc(obj->str_val);
+	} else if (obj->type == CARROT_LIST) {
+		size += arrcap(obj->list_items) * sizeof(CarrotValue);
+		if (obj->repr != NULL) size += sdsalloc(obj->repr);
+	} else if (obj->type == CARROT_RANGE) {
+		if (obj->repr != NULL) size += sdsalloc(obj->repr);
+	}
+	return size;
+}
+
+void carrot_release(CarrotObj *obj) {
+	/* Frees obj once its last reference is dropped, along with the
+	 * items only it referenced */
+	CARROT_STATS.objects_released++;
+	if (obj->type == CARROT_LIST) {
+		for (int i = 0; i < arrlen(obj->list_items); i++) {
+			carrot_decref(obj->list_items[i]);
+		}
 	}
-
-	shfree(CARROT_TRACKING_ARR);
+	carrot_free(obj);
 }
 
 void carrot_free(CarrotObj *root) {
 	/* It only frees the members of root. If root member is a pointer
 	 * to array of allocated objects, it should be freed manually somewhere
 	 * else */
-	if (arrlen(root->list_items) >= 0) arrfree(root->list_items);
-	if (arrlen(root->func_arg_names) >= 0) arrfree(root->func_arg_names);
-	free(root->hash);
-	sdsfree(root->repr);
-	sdsfree(root->type_str);
-	sdsfree(root->str_val);
-	free(root);
+	if (root->prev != NULL) root->prev->next = root->next;
+	else CARROT_HEAP_OBJS = root->next;
+	if (root->next != NULL) root->next->prev = root->prev;
+
+	carrot_gc_release(root);
+	CARROT_STATS.objects_live--;
+	switch (root->type) {
+		case CARROT_STR:
+			sdsfree(root->str_val);
+			break;
+		case CARROT_LIST:
+			arrfree(root->list_items);
+			sdsfree(root->repr);
+			break;
+		case CARROT_RANGE:
+			sdsfree(root->repr);
+			break;
+		default:
+			break;
+	}
+	carrot_pool_free(root, sizeof(CarrotObj));
 }
 
+/* Indexed by carrot_dtype_t */
+const CarrotType CARROT_TYPES[] = {
+	[CARROT_STR] = {"str"},
+	[CARROT_INT] = {"int"},
+	[CARROT_FLOAT] = {"float"},
+	[CARROT_BOOL] = {"bool"},
+	[CARROT_LIST] = {"list", carrot_list_iter_next},
+	[CARROT_NULL] = {"null"},
+	[CARROT_FUNCTION] = {"function"},
+	[CARROT_RANGE] = {"list", carrot_range_iter_next},
+	[CARROT_UNDEFINED] = {"undefined"},
+};
+
 void carrot_init() {
-	/* Initialize hashtable that tracks CarrotObj's allocated in heap */
-	CARROT_TRACKING_ARR = NULL;
-	sh_new_strdup(CARROT_TRACKING_ARR);
+	CARROT_HEAP_OBJS = NULL;
+	CARROT_STR_CONSTS = NULL;
+	carrot_gc_add_marker(carrot_mark_str_consts, NULL);
 }
 
 void interpreter_free(Interpreter *interpreter) {
-	/* Frees the members of interpreter struct as well as
-	 * the content of symbol table. */
-	int len = shlen(interpreter->sym_table);
-	for (int i = 0; i < len; i++) {
-		CarrotObj* obj = interpreter->sym_table[i].value;
-		char *hash = obj->hash;
-		char *key = interpreter->sym_table[i].key;
-		shdel(CARROT_TRACKING_ARR, hash);
-		shdel(interpreter->sym_table, key);
-		carrot_free(obj);
-	}
-	shfree(interpreter->sym_table);
+	/* Frees the members of interpreter struct, and drops the references
+	 * held by its variables */
+	for (int i = 0; i < scope_layout_size(interpreter->layout); i++) {
+		carrot_decref(interpreter->slots[i]);
+	}
+	for (int i = 0; i < hmlen(interpreter->sym_table); i++) {
+		carrot_decref(interpreter->sym_table[i].value);
+	}
+	hmfree(interpreter->sym_table);
+	if (interpreter->globals == interpreter) free(interpreter->slots);
 }
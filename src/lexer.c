@@ -2,24 +2,60 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include "../include/intern.h"
 #include "../include/lexer.h"
 #include "../include/logutils.h"
 
 
-int is_keyword(char *s) {
-	int n_keywords = 4;
-	char keywords[4][20] = {
-		#include "../spec/keywords"
-	};
+typedef struct KEYWORD {
+	char       *text;
+	int        len;
+	tok_kind_t kind;
+} Keyword;
 
-	int found = 0;
-	for (int i = 0; i < n_keywords; i++) {
-		if (strcmp(s, keywords[i]) == 0) {
-			found = 1;
-			break;
-		}
-	}
-	return found;
+/* Perfect hash of the keywords: no two of them share a slot, so a word
+ * is a keyword only if it matches the single entry of its slot. The
+ * table is generated by spec/gen_keywords.py, the asserts below check
+ * it again at build time. */
+#define KEYWORD_TABLE_SIZE 16
+#define KEYWORD_HASH(first, last, len) \
+	((((first) << 3) + (last) + (len)) & (KEYWORD_TABLE_SIZE - 1))
+
+#define KEYWORD(slot, text, first, last, kind) [slot] = {text, sizeof(text) - 1, kind},
+static const Keyword KEYWORDS[KEYWORD_TABLE_SIZE] = {
+	#include "../spec/keywords"
+};
+#undef KEYWORD
+
+/* Every keyword is in the slot of its hash */
+#define KEYWORD(slot, text, first, last, kind) \
+	_Static_assert(KEYWORD_HASH(first, last, sizeof(text) - 1) == (slot), \
+	               "Keyword " text " is not in the slot of its hash");
+#include "../spec/keywords"
+#undef KEYWORD
+
+/* The slot bits only add up to their union if no slot is used twice */
+enum {
+#define KEYWORD(slot, text, first, last, kind) + (1u << (slot))
+	KEYWORD_SLOT_SUM = 0
+	#include "../spec/keywords"
+	,
+#undef KEYWORD
+#define KEYWORD(slot, text, first, last, kind) | (1u << (slot))
+	KEYWORD_SLOT_UNION = 0
+	#include "../spec/keywords"
+#undef KEYWORD
+};
+_Static_assert(KEYWORD_SLOT_SUM == KEYWORD_SLOT_UNION,
+               "Two keywords share a slot of the keyword table");
+
+tok_kind_t keyword_kind(char *s, int len) {
+	/* The token kind of the word s of length len, T_ID if it is not a
+	 * keyword */
+	if (len == 0) return T_ID;
+	const Keyword *kw = &KEYWORDS[KEYWORD_HASH(s[0], s[len - 1], len)];
+	if (kw->len == len && memcmp(kw->text, s, len) == 0) return kw->kind;
+	return T_ID;
 }
 
 int is_escape(char* s) {
@@ -55,102 +91,121 @@ static char make_escape(char* s) {
 	return 0; // is not found
 }
 
-Token create_token(tok_kind_t tok_kind, char *text) {
+Token create_token(tok_kind_t tok_kind, int start, int len) {
 	Token t;
 	t.tok_kind = tok_kind;
-	strncpy(t.text, text, MAX_TOKEN_TEXT_LEN);
+	t.start = start;
+	t.len = len;
+	t.name = NULL;
+	t.line_num = 0;   // set by lexer_add_token()
 	return t;
 }
 
 void make_identifier(Lexer *lexer) {
-	int i = 0;
-	char s[MAX_TOKEN_TEXT_LEN] = "";
+	int start = lexer->idx;
 	while (isalpha(lexer->c) || lexer->c == '_') {
-		s[i++] = lexer->c;
 		lexer_next(lexer);
 	}
-	s[i] = '\0';
 
-	if (is_keyword(s)) {
-		lexer_add_token(lexer, create_token(T_KEYWORD, s));
-	} else {
-		lexer_add_token(lexer, create_token(T_ID, s));
-	}
+	char *text = lexer->source + start;
+	int len = lexer->idx - start;
+	Token t = create_token(keyword_kind(text, len), start, len);
+	t.name = carrot_intern_len(text, len);
+	lexer_add_token(lexer, t);
 }
 
 void make_number(Lexer *lexer) {
-	int i = 0;
+	int start = lexer->idx;
 	int num_dot = 0;
-	char s[MAX_TOKEN_TEXT_LEN] = "";
 	while (isdigit(lexer->c) || lexer->c == '.') {
 		if (lexer->c == '.') num_dot++;
-		s[i++] = lexer->c;
 		lexer_next(lexer);
 	}
-	s[i] = '\0';
+	int len = lexer->idx - start;
 
 	if (num_dot > 1) {
 		char msg[255];
 		snprintf(msg, 255, "I saw an invalid number format in '%s' at line %d. "
-			 "You typed: %s\n",
+			 "You typed: %.*s\n",
 			 "foo",
 			 lexer->line_num,
-			 s);
+			 len, lexer->source + start);
 		carrot_log_error(msg, "idklol", -1);
 		exit(1);
 	}
 
 	if (num_dot == 1) {
-		lexer_add_token(lexer, create_token(T_FLOAT, s));
+		lexer_add_token(lexer, create_token(T_FLOAT, start, len));
 	} else {
-		lexer_add_token(lexer, create_token(T_INT, s));
+		lexer_add_token(lexer, create_token(T_INT, start, len));
 	}
 }
 
-void make_single_char_token(Lexer *lexer, tok_kind_t kind, char *text) {
-	lexer_add_token(lexer, create_token(kind, text));
+void make_single_char_token(Lexer *lexer, tok_kind_t kind) {
+	lexer_add_token(lexer, create_token(kind, lexer->idx, 1));
 	lexer_next(lexer);
 }
 
-void make_two_chars_token(Lexer *lexer, tok_kind_t kind, char *text) {
-	lexer_add_token(lexer, create_token(kind, text));
+void make_two_chars_token(Lexer *lexer, tok_kind_t kind) {
+	lexer_add_token(lexer, create_token(kind, lexer->idx, 2));
 	lexer_next(lexer);
 	lexer_next(lexer);
 }
 
 void make_string(Lexer *lexer) {
+	/* The escapes are only checked here, they are decoded when the
+	 * parser asks for the text, see lexer_token_str() */
 	lexer_next(lexer);
-	char s[MAX_TOKEN_TEXT_LEN] = "";
-	int i = 0;
+	int start = lexer->idx;
 	while (lexer->c != '"') {
+		if (lexer->c == '\0') {
+			fprintf(stderr, "Unterminated string at line %d.\n", lexer->line_num);
+			exit(1);
+		}
 		if (lexer->c == '\\') {
-			/* Scan for escape characters */
-			/* Case that should be taken care of:
-			   lexer->source[++lexer->idx] pasts the array
-			*/
-			char e[3] = {lexer->c, lexer->source[++lexer->idx], 0};
-			if (is_escape(e)) {
-				s[i++] = make_escape(e);
-			}
-			else {
+			char e[3] = {lexer->c, lexer->source[lexer->idx + 1], 0};
+			if (!is_escape(e)) {
 				fprintf(stderr, "Illegal escape character %s at line %d.\n", e, lexer->line_num);
 				exit(1);
 			}
-		} else {
-			s[i++] = lexer->c;
+			lexer_next(lexer);
 		}
 		lexer_next(lexer);
 	}
-	
+	int len = lexer->idx - start;
+
 	// found enclosing delimiter
 	lexer_next(lexer);
-	s[i] = '\0';
+	lexer_add_token(lexer, create_token(T_STR, start, len));
+}
 
-	lexer_add_token(lexer, create_token(T_STR, s));
+char *lexer_token_str(Lexer *lexer, Token t) {
+	/* Interned text of a string literal, with its escapes decoded */
+	char *text = lexer->source + t.start;
+	if (memchr(text, '\\', t.len) == NULL) return carrot_intern_len(text, t.len);
+
+	char *decoded = malloc(t.len + 1);
+	int len = 0;
+	for (int i = 0; i < t.len; i++) {
+		if (text[i] == '\\') {
+			char e[3] = {text[i], text[i + 1], 0};
+			decoded[len++] = make_escape(e);
+			i++;
+		} else {
+			decoded[len++] = text[i];
+		}
+	}
+	char *interned = carrot_intern_len(decoded, len);
+	free(decoded);
+	return interned;
 }
 
 void lexer_add_token(Lexer *lexer, Token t) {
-	lexer->tokens[lexer->token_cnt++] = t;
+	t.line_num = lexer->line_num;
+	int idx = (lexer->lookahead_start + lexer->lookahead_cnt) &
+	          (LEXER_LOOKAHEAD - 1);
+	lexer->lookahead[idx] = t;
+	lexer->lookahead_cnt++;
 }
 
 void lexer_init(Lexer *lexer, char *source) {
@@ -158,7 +213,8 @@ void lexer_init(Lexer *lexer, char *source) {
 	lexer->line_num = 1;
 	lexer->source = source;
 	lexer->c = lexer->source[0];
-	lexer->token_cnt = 0;
+	lexer->lookahead_start = 0;
+	lexer->lookahead_cnt = 0;
 }
 
 void lexer_next(Lexer *lexer) {
@@ -167,11 +223,11 @@ void lexer_next(Lexer *lexer) {
 }
 
 void lexer_skip_comment(Lexer *lexer) {
+	/* The newline itself is left to lexer_skip_whitespace() */
 	if (lexer->source[lexer->idx+1] == '-') {
-		while (lexer->c != '\n') {
+		while (lexer->c != '\n' && lexer->c != '\0') {
 			lexer_next(lexer);
 		}
-		lexer->line_num++;
 	}
 }
 
@@ -182,11 +238,37 @@ void lexer_skip_whitespace(Lexer *lexer) {
 	}
 }
 
+Token lexer_next_token(Lexer *lexer) {
+	/* Consumes the next token, scanning it first if needed. Once the
+	 * source is exhausted, T_EOF is returned forever. */
+	if (lexer->lookahead_cnt == 0) lexer_lex(lexer);
+
+	Token t = lexer->lookahead[lexer->lookahead_start];
+	lexer->lookahead_start = (lexer->lookahead_start + 1) &
+	                         (LEXER_LOOKAHEAD - 1);
+	lexer->lookahead_cnt--;
+	return t;
+}
+
+Token lexer_peek_token(Lexer *lexer, int n) {
+	/* Returns the token n positions after the next one, n being less
+	 * than LEXER_LOOKAHEAD, without consuming anything */
+	while (lexer->lookahead_cnt <= n) lexer_lex(lexer);
+	return lexer->lookahead[(lexer->lookahead_start + n) &
+	                        (LEXER_LOOKAHEAD - 1)];
+}
+
 /*===========================================================================
  *Lexical Analysis
  *===========================================================================*/
 void lexer_lex(Lexer *lexer) {
-	while (lexer->c != '\0') {
+	/* Scans exactly one token into the lookahead buffer */
+	int lookahead_cnt = lexer->lookahead_cnt;
+	while (lexer->lookahead_cnt == lookahead_cnt) {
+		if (lexer->c == '\0') {
+			lexer_add_token(lexer, create_token(T_EOF, lexer->idx, 0));
+			return;
+		}
 		if (isspace(lexer->c)) {
 			lexer_skip_whitespace(lexer);
 			continue;
@@ -201,79 +283,79 @@ void lexer_lex(Lexer *lexer) {
 			continue;
 		} else if (lexer->c == '=') {
 			if (lexer->source[lexer->idx+1] == '=') {
-				make_two_chars_token(lexer, T_EE, "==");
+				make_two_chars_token(lexer, T_EE);
 			} else {
-				make_single_char_token(lexer, T_EQUAL, "=");
+				make_single_char_token(lexer, T_EQUAL);
 			}
 			continue;
 		} else if (lexer->c == '>') {
 			if (lexer->source[lexer->idx+1] == '=') {
-				make_two_chars_token(lexer, T_GE, ">=");
+				make_two_chars_token(lexer, T_GE);
 			} else {
-				make_single_char_token(lexer, T_GT, ">");
+				make_single_char_token(lexer, T_GT);
 			}
 			continue;
 		} else if (lexer->c == '<') {
 			if (lexer->source[lexer->idx+1] == '=') {
-				make_two_chars_token(lexer, T_LE, "<=");
+				make_two_chars_token(lexer, T_LE);
 			} else {
-				make_single_char_token(lexer, T_LT, "<");
+				make_single_char_token(lexer, T_LT);
 			}
 			continue;
 		} else if (lexer->c == '!') {
 			if (lexer->source[lexer->idx+1] == '=') {
-				make_two_chars_token(lexer, T_NE, "!=");
+				make_two_chars_token(lexer, T_NE);
 			} else {
-				make_single_char_token(lexer, T_NOT, "!");
+				make_single_char_token(lexer, T_NOT);
 			}
 			continue;
 		} else if (lexer->c == '|') {
 			if (lexer->source[lexer->idx+1] == '|') {
-				make_two_chars_token(lexer, T_OR, "||");
+				make_two_chars_token(lexer, T_OR);
 			}
 			continue;
 		} else if (lexer->c == '&') {
 			if (lexer->source[lexer->idx+1] == '&') {
-				make_two_chars_token(lexer, T_AND, "&&");
+				make_two_chars_token(lexer, T_AND);
 			}
 			continue;
 		} else if (lexer->c == '(') {
-			make_single_char_token(lexer, T_LPAREN, "(");
+			make_single_char_token(lexer, T_LPAREN);
 			continue;
 		} else if (lexer->c == ')') {
-			make_single_char_token(lexer, T_RPAREN, ")");
+			make_single_char_token(lexer, T_RPAREN);
 			continue;
 		} else if (lexer->c == '[') {
-			make_single_char_token(lexer, T_LBRACKET, "[");
+			make_single_char_token(lexer, T_LBRACKET);
 			continue;
 		} else if (lexer->c == ']') {
-			make_single_char_token(lexer, T_RBRACKET, "]");
+			make_single_char_token(lexer, T_RBRACKET);
 			continue;
 		} else if (lexer->c == ',') {
-			make_single_char_token(lexer, T_COMMA, ",");
+			make_single_char_token(lexer, T_COMMA);
 			continue;
 		} else if (lexer->c == '+') {
-			make_single_char_token(lexer, T_PLUS, "+");
+			make_single_char_token(lexer, T_PLUS);
 			continue;
 		} else if (lexer->c == '*') {
-			make_single_char_token(lexer, T_MULT, "*");
+			make_single_char_token(lexer, T_MULT);
 			continue;
 		} else if (lexer->c == '/') {
-			make_single_char_token(lexer, T_DIV, "/");
+			make_single_char_token(lexer, T_DIV);
 			continue;
 		}else if (lexer->c == ':') {
-			make_single_char_token(lexer, T_COLON, ":");
+			make_single_char_token(lexer, T_COLON);
 			continue;
 		} else if (lexer->c == '@') {
-			make_single_char_token(lexer, T_AT, "@");
+			make_single_char_token(lexer, T_AT);
 			continue;
 		} else if (lexer->c == '-') {
 			if (lexer->source[lexer->idx+1] == '-') {
 				lexer_skip_comment(lexer);
 			} else if (lexer->source[lexer->idx+1] == '>') {
-				make_two_chars_token(lexer, T_RARROW, "->");
+				make_two_chars_token(lexer, T_RARROW);
 			} else {
-				make_single_char_token(lexer, T_MINUS, "-");
+				make_single_char_token(lexer, T_MINUS);
 			}
 			continue;
 		} else {
@@ -284,5 +366,4 @@ void lexer_lex(Lexer *lexer) {
 		}
 		lexer_next(lexer);
 	}
-	lexer_add_token(lexer, create_token(T_EOF, "EOF"));
 }
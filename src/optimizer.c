@@ -0,0 +1,160 @@
+#include <limits.h>
+#include <string.h>
+#include "../include/optimizer.h"
+#include "../include/interpreter.h"
+#include "../include/intern.h"
+#include "../lib/include/stb_ds.h"
+
+static int literal_value(Node *node, CarrotValue *value) {
+	/* Stores the value of an immediate literal, returns 0 for other
+	 * nodes */
+	if (node->type != N_LITERAL) return 0;
+	switch (node->var_type) {
+		case DT_INT:   *value = carrot_int(node->int_val); return 1;
+		case DT_FLOAT: *value = carrot_float(node->float_val); return 1;
+		case DT_BOOL:  *value = carrot_bool(node->bool_val); return 1;
+		default:       return 0;
+	}
+}
+
+static void literal_set(Node *node, CarrotValue value) {
+	/* Turns node into the literal of an immediate value. Every node
+	 * kind shares the header, only the fields of the kind change. */
+	node->type = N_LITERAL;
+	switch (value.type) {
+		case CARROT_INT:
+			node->var_type = DT_INT;
+			node->int_val = value.int_val;
+			break;
+		case CARROT_FLOAT:
+			node->var_type = DT_FLOAT;
+			node->float_val = value.float_val;
+			break;
+		default:
+			node->var_type = DT_BOOL;
+			node->bool_val = value.bool_val;
+	}
+	node->static_type = node->var_type;
+}
+
+static void literal_set_str(Node *node, char *str_val) {
+	node->type = N_LITERAL;
+	node->var_type = DT_STR;
+	node->str_val = carrot_intern(str_val);
+	node->static_type = DT_STR;
+}
+
+/*===========================================================================
+ * Constant folding
+ *===========================================================================*/
+static void optimizer_fold_str(Node *node, char *left, char *right) {
+	if (node->op == OPR_ADD) {
+		sds cat = sdscat(sdsnew(left), right);
+		literal_set_str(node, cat);
+		sdsfree(cat);
+	} else if (node->op == OPR_EE || node->op == OPR_NE) {
+		int equal = strcmp(left, right) == 0;
+		literal_set(node, carrot_bool(node->op == OPR_EE ? equal : !equal));
+	}
+}
+
+static void optimizer_fold_binop(Node *node) {
+	Node *left = node->left;
+	Node *right = node->right;
+	if (left->type == N_LITERAL && left->var_type == DT_STR &&
+	    right->type == N_LITERAL && right->var_type == DT_STR) {
+		optimizer_fold_str(node, left->str_val, right->str_val);
+		return;
+	}
+
+	CarrotValue left_val, right_val;
+	if (!literal_value(left, &left_val) || !literal_value(right, &right_val))
+		return;
+	carrot_binop_t handler = CARROT_BINOPS[left_val.type][right_val.type][node->op];
+	if (handler == NULL) return;
+
+	/* An integer division that traps is left to fail if it is executed */
+	if (node->op == OPR_DIV && left_val.type == CARROT_INT &&
+	    right_val.type == CARROT_INT &&
+	    (right_val.int_val == 0 ||
+	     (right_val.int_val == -1 && left_val.int_val == INT_MIN)))
+		return;
+
+	literal_set(node, handler(left_val, right_val));
+}
+
+static void optimizer_fold_unop(Node *node) {
+	if (node->op == OPR_PLUS) {
+		/* unary plus gives back its operand as is */
+		int line = node->line;
+		*node = *node->right;
+		node->line = line;
+		return;
+	}
+
+	CarrotValue right;
+	if (!literal_value(node->right, &right)) return;
+	if ((node->op == OPR_NOT && right.type == CARROT_BOOL) ||
+	    (node->op == OPR_NEGATE && right.type != CARROT_BOOL))
+		literal_set(node, carrot_unop(node->op, right));
+}
+
+/*===========================================================================
+ * Dead branch elimination
+ *===========================================================================*/
+static void optimizer_prune_if(Node *node) {
+	/* A literal condition is decided before execution: a false branch
+	 * is dropped, and a true one becomes the else block in place of the
+	 * branches after it */
+	int kept = 0;
+	for (int i = 0; i < node->conditions.len; i++) {
+		Node *condition = node->conditions.items[i];
+		if (condition->type == N_LITERAL) {
+			if (condition->var_type == DT_BOOL && condition->bool_val) {
+				node->else_block = node->if_blocks.items[i];
+				break;
+			}
+			continue;
+		}
+		node->conditions.items[kept] = condition;
+		node->if_blocks.items[kept] = node->if_blocks.items[i];
+		kept++;
+	}
+	node->conditions.len = kept;
+	node->if_blocks.len = kept;
+	if (kept > 0) return;
+
+	/* The if blocks share the scope of the if statement, so the
+	 * remaining block can take its place */
+	Node *else_block = node->else_block;
+	node->type = N_BLOCK;
+	node->block_statements.items = NULL;
+	node->block_statements.len = 0;
+	if (else_block != NULL) node->block_statements = else_block->block_statements;
+}
+
+static void optimizer_visit(void *data, Node *node) {
+	int level = *(int *) data;
+	node_visit_children(node, optimizer_visit, data);
+	switch (node->type) {
+		case N_BINOP:
+			optimizer_fold_binop(node);
+			break;
+		case N_UNOP:
+			optimizer_fold_unop(node);
+			break;
+		case N_IF:
+			if (level >= 2) optimizer_prune_if(node);
+			break;
+		default:
+			break;
+	}
+}
+
+/*===========================================================================
+ * Optimization
+ *===========================================================================*/
+void optimizer_optimize(Node *script, int level) {
+	if (level <= 0) return;
+	optimizer_visit(&level, script);
+}
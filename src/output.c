@@ -0,0 +1,143 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/output.h"
+
+static char           *output_buffer = NULL;
+static size_t         output_size = CARROT_OUTPUT_DEFAULT_SIZE;
+static size_t         output_len = 0;
+static carrot_flush_t output_policy = CARROT_FLUSH_DEFAULT;
+
+static void output_write_fd(const char *s, size_t len) {
+	/* Bypasses stdio, so that at exit the buffer is written out before
+	 * the messages that were printed with printf() after it */
+	while (len > 0) {
+		ssize_t n = write(STDOUT_FILENO, s, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return;   // e.g. closed pipe, the output is lost
+		}
+		s += n;
+		len -= n;
+	}
+}
+
+void carrot_output_configure(size_t size, carrot_flush_t policy) {
+	if (output_buffer == NULL) atexit(carrot_output_flush);
+	else carrot_output_flush();
+
+	if (policy == CARROT_FLUSH_DEFAULT)
+		policy = isatty(STDOUT_FILENO) ? CARROT_FLUSH_LINE : CARROT_FLUSH_FULL;
+	output_policy = policy;
+	output_size = size > 0 ? size : 1;
+	output_buffer = realloc(output_buffer, output_size);
+	if (output_buffer == NULL) {
+		printf("ERROR: Out of memory\n");
+		exit(1);
+	}
+}
+
+void carrot_output_write(const char *s, size_t len) {
+	if (output_buffer == NULL)
+		carrot_output_configure(output_size, output_policy);
+
+	if (output_len + len > output_size) {
+		carrot_output_flush();
+		if (len >= output_size) {
+			/* too large to be buffered */
+			output_write_fd(s, len);
+			return;
+		}
+	}
+	memcpy(output_buffer + output_len, s, len);
+	output_len += len;
+
+	if (output_policy == CARROT_FLUSH_LINE && memchr(s, '\n', len) != NULL)
+		carrot_output_flush();
+}
+
+void carrot_output_str(const char *s) {
+	carrot_output_write(s, strlen(s));
+}
+
+static void output_int(int value) {
+	/* Same digits as printf("%d") */
+	char digits[16];
+	char *end = digits + sizeof(digits);
+	char *p = end;
+	unsigned int u = value < 0 ? -(unsigned int) value : (unsigned int) value;
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+	} while (u > 0);
+	if (value < 0) *--p = '-';
+	carrot_output_write(p, end - p);
+}
+
+static void output_list(CarrotObj *list) {
+	/* Writes the items one by one instead of building the whole
+	 * representation first, see carrot_obj_repr() */
+	CarrotIterator iter;
+	CarrotValue item;
+	carrot_output_write("[", 1);
+	carrot_iter_init(&iter, carrot_obj_value(list));
+	while (carrot_iter_next(&iter, &item)) {
+		if (iter.idx > 1)
+			carrot_output_write(", ", 2);
+
+		if (item.type == CARROT_STR) {
+			carrot_output_write("\"", 1);
+			carrot_output_value(item);
+			carrot_output_write("\"", 1);
+		} else {
+			carrot_output_value(item);
+		}
+	}
+	carrot_output_write("]", 1);
+}
+
+void carrot_output_value(CarrotValue value) {
+	/* Writes the representation of value, the one of carrot_repr_cat() */
+	char buf[64];
+	switch (value.type) {
+		case CARROT_INT:
+			output_int(value.int_val);
+			break;
+		case CARROT_FLOAT:
+			carrot_output_write(buf, snprintf(buf, sizeof(buf), "%f", value.float_val));
+			break;
+		case CARROT_BOOL:
+			carrot_output_str(value.bool_val == 1 ? "true" : "false");
+			break;
+		case CARROT_NULL:
+			carrot_output_write("null", 4);
+			break;
+		case CARROT_STR:
+			carrot_output_write(value.obj->str_val, sdslen(value.obj->str_val));
+			break;
+		case CARROT_LIST:
+		case CARROT_RANGE:
+			if (value.obj->repr != NULL) {
+				carrot_output_write(value.obj->repr, sdslen(value.obj->repr));
+			} else {
+				output_list(value.obj);
+			}
+			break;
+		default:
+			carrot_output_str(carrot_obj_repr(value.obj));
+	}
+}
+
+void carrot_output_flush() {
+	if (output_len == 0) return;
+	output_write_fd(output_buffer, output_len);
+	output_len = 0;
+}
+
+void carrot_output_finalize() {
+	carrot_output_flush();
+	free(output_buffer);
+	output_buffer = NULL;
+}
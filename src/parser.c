@@ -4,72 +4,297 @@
 #include "../include/lexer.h"
 #include "../include/parser.h"
 #include "../include/logutils.h"
+#include "../include/stats.h"
 
 #define STB_DS_IMPLEMENTATION
+#define STBDS_STATISTICS   // counters reported by --stats
 #include "../lib/include/stb_ds.h"
 
-Node **NODE_TRACKING_ARR = NULL;
-
-Node *init_node() {
-	Node *n = malloc(sizeof(Node));
-	n->type = N_UNKNOWN;
-	n->var_type = DT_UNKNOWN;
-	n->block_statements = NULL;
-	n->conditions = NULL;
-	n->if_blocks = NULL;
-	n->else_block = NULL;
-	n->obj_val = NULL;
-	n->list_items = NULL;
-	n->statements = NULL;
-	n->var_node = NULL;
-	n->func_params = NULL;
-	n->func_statements = NULL;
-	n->func_args = NULL;
-	n->iterable = NULL;
-	n->loop_statements = NULL;
-	n->return_value = NULL;
-	arrput(NODE_TRACKING_ARR, n);
+Node *init_node(Parser *parser, node_type_t type) {
+	/* The arena hands out zeroed memory, so every field of the node
+	 * kind starts as 0 or NULL */
+	Node *n = arena_alloc(parser->arena, sizeof(Node));
+	CARROT_STATS.nodes++;
+	n->type = type;
+	n->line = parser->current_token.line_num;
+	n->static_type = DT_UNKNOWN;
+	n->var_resolution = RES_DYNAMIC;
+	n->scope_layout = NULL;
 	return n;
 }
 
-void free_node(Node *node) {
-	int len = arrlen(NODE_TRACKING_ARR);
-	for (int i = 0; i < len; i++) {
-		Node *n = NODE_TRACKING_ARR[i];
-		n->iterable = NULL;
-		n->loop_statements = NULL;
-
-		if (n->block_statements != NULL) arrfree(n->block_statements);
-		if (n->conditions != NULL) arrfree(n->conditions);
-		if (n->if_blocks != NULL) arrfree(n->if_blocks);
-		if (n->list_items != NULL) arrfree(n->list_items);
-		if (n->func_args != NULL) arrfree(n->func_args);
-		if (n->func_statements != NULL) arrfree(n->func_statements);
-		if (n->func_params != NULL) arrfree(n->func_params);
-		if (n->loop_statements != NULL) arrfree(n->loop_statements);
-		free(n);
+void free_node(Node *script) {
+	/* Releases a script returned by parser_parse(), along with every
+	 * node, name and scope layout of it */
+	for (int i = 0; i < arrlen(script->layouts); i++) {
+		hmfree(script->layouts[i]->slots);
 	}
-	arrfree(NODE_TRACKING_ARR);
+	arrfree(script->layouts);
+
+	Arena *arena = script->arena;
+	arena_free(arena);
+	free(arena);
+}
+
+static NodeList parser_node_list(Parser *parser, Node **nodes) {
+	/* Moves the stb_ds array nodes, built while parsing, into the arena */
+	NodeList list;
+	list.len = arrlen(nodes);
+	list.items = arena_alloc(parser->arena, list.len * sizeof(Node *));
+	if (list.len > 0) memcpy(list.items, nodes, list.len * sizeof(Node *));
+	arrfree(nodes);
+	return list;
 }
 
 Token parser_consume(Parser *parser) {
 	Token token = parser->current_token;
-
-	parser->i++;
-	parser->current_token = parser->lexer.tokens[parser->i];
+	parser->current_token = lexer_next_token(&parser->lexer);
 	return token;
 }
 
 void parser_init(Parser *parser, char *source) {
 	lexer_init(&parser->lexer, source);
-	lexer_lex(&parser->lexer);
-	parser->i = 0;
-	parser->current_token = parser->lexer.tokens[0];
-	parser->node_cnt = 0;
+	parser->current_token = lexer_next_token(&parser->lexer);
+	parser->arena = malloc(sizeof(Arena));
+	arena_init(parser->arena);
 }
 
 Token parser_lookahed(Parser *parser) {
-	return parser->lexer.tokens[parser->i + 1];
+	return lexer_peek_token(&parser->lexer, 0);
+}
+
+static operator_t parser_operator(tok_kind_t kind, int unary) {
+	/* Maps an operator token to the operator stored in the node, so
+	 * the interpreters never have to look at the token text */
+	switch (kind) {
+		case T_PLUS:  return unary ? OPR_PLUS : OPR_ADD;
+		case T_MINUS: return unary ? OPR_NEGATE : OPR_SUBTRACT;
+		case T_MULT:  return OPR_MULT;
+		case T_DIV:   return OPR_DIV;
+		case T_EE:    return OPR_EE;
+		case T_NE:    return OPR_NE;
+		case T_GT:    return OPR_GT;
+		case T_LT:    return OPR_LT;
+		case T_GE:    return OPR_GE;
+		case T_LE:    return OPR_LE;
+		case T_AND:   return OPR_AND;
+		case T_OR:    return OPR_OR;
+		case T_NOT:   return OPR_NOT;
+		default:      return OPR_UNKNOWN;
+	}
+}
+
+char *operator_to_str(operator_t op) {
+	switch (op) {
+		case OPR_ADD:      return "+";
+		case OPR_SUBTRACT: return "-";
+		case OPR_MULT:     return "*";
+		case OPR_DIV:      return "/";
+		case OPR_EE:       return "==";
+		case OPR_NE:       return "!=";
+		case OPR_GT:       return ">";
+		case OPR_LT:       return "<";
+		case OPR_GE:       return ">=";
+		case OPR_LE:       return "<=";
+		case OPR_AND:      return "&&";
+		case OPR_OR:       return "||";
+		case OPR_NOT:      return "!";
+		case OPR_NEGATE:   return "-";
+		case OPR_PLUS:     return "+";
+		default:           return "?";
+	}
+}
+
+data_type_t data_type_from_str(char *type_str) {
+	/* The type named in a declaration, "void" being the type of null */
+	if (type_str == NULL) return DT_UNKNOWN;
+	if (strcmp(type_str, "str") == 0) return DT_STR;
+	if (strcmp(type_str, "int") == 0) return DT_INT;
+	if (strcmp(type_str, "float") == 0) return DT_FLOAT;
+	if (strcmp(type_str, "bool") == 0) return DT_BOOL;
+	if (strcmp(type_str, "list") == 0) return DT_LIST;
+	if (strcmp(type_str, "null") == 0) return DT_NULL;
+	if (strcmp(type_str, "void") == 0) return DT_NULL;
+	if (strcmp(type_str, "func") == 0) return DT_FUNC;
+	return DT_UNKNOWN;
+}
+
+char *data_type_to_str(data_type_t type) {
+	/* Same names as the runtime types, see CARROT_TYPES */
+	switch (type) {
+		case DT_STR:   return "str";
+		case DT_INT:   return "int";
+		case DT_FLOAT: return "float";
+		case DT_BOOL:  return "bool";
+		case DT_LIST:  return "list";
+		case DT_NULL:  return "null";
+		case DT_FUNC:  return "function";
+		default:       return "unknown";
+	}
+}
+
+static void node_visit_all(NodeList nodes, node_visitor_t visitor, void *data) {
+	for (int i = 0; i < nodes.len; i++) {
+		visitor(data, nodes.items[i]);
+	}
+}
+
+void node_visit_children(Node *node, node_visitor_t visitor, void *data) {
+	/* Calls visitor on every direct child of node, in evaluation order */
+	switch (node->type) {
+		case N_BLOCK:
+			node_visit_all(node->block_statements, visitor, data);
+			break;
+		case N_STATEMENTS:
+			node_visit_all(node->statements, visitor, data);
+			break;
+		case N_BINOP:
+			visitor(data, node->left);
+			visitor(data, node->right);
+			break;
+		case N_UNOP:
+			visitor(data, node->right);
+			break;
+		case N_FUNC_DEF:
+			node_visit_all(node->func_statements, visitor, data);
+			break;
+		case N_FUNC_CALL:
+			visitor(data, node->callee);
+			node_visit_all(node->func_args, visitor, data);
+			break;
+		case N_GET_ITEM:
+			visitor(data, node->list_node);
+			visitor(data, node->index_node);
+			break;
+		case N_IF:
+			for (int i = 0; i < node->conditions.len; i++) {
+				visitor(data, node->conditions.items[i]);
+				visitor(data, node->if_blocks.items[i]);
+			}
+			if (node->else_block != NULL) visitor(data, node->else_block);
+			break;
+		case N_ITER:
+			visitor(data, node->iterable);
+			node_visit_all(node->loop_statements, visitor, data);
+			break;
+		case N_LITERAL:
+			if (node->var_type == DT_LIST)
+				node_visit_all(node->list_items, visitor, data);
+			break;
+		case N_RETURN:
+			visitor(data, node->return_value);
+			break;
+		case N_VAR_DEF:
+		case N_VAR_ASSIGN:
+			visitor(data, node->var_node);
+			break;
+		default:
+			break;
+	}
+}
+
+static void node_dump_str(char *str) {
+	putchar('"');
+	for (char *c = str; *c != '\0'; c++) {
+		if (*c == '\n') printf("\\n");
+		else if (*c == '\t') printf("\\t");
+		else putchar(*c);
+	}
+	putchar('"');
+}
+
+static void node_dump_child(void *data, Node *node) {
+	node_dump(node, *(int *) data);
+}
+
+static void node_dump_all(NodeList nodes, int depth) {
+	for (int i = 0; i < nodes.len; i++) {
+		node_dump(nodes.items[i], depth);
+	}
+}
+
+void node_dump(Node *node, int depth) {
+	/* One line per node, children indented below their parent. The
+	 * static type of an expression follows it when known. */
+	printf("%*s", depth * 2, "");
+	switch (node->type) {
+		case N_STATEMENTS:
+			printf("statements\n");
+			node_dump_all(node->statements, depth + 1);
+			return;
+		case N_BLOCK:
+			printf("block\n");
+			node_dump_all(node->block_statements, depth + 1);
+			return;
+		case N_LITERAL:
+			printf("literal ");
+			switch (node->var_type) {
+				case DT_INT:   printf("%d", node->int_val); break;
+				case DT_FLOAT: printf("%f", node->float_val); break;
+				case DT_BOOL:  printf("%s", node->bool_val ? "true" : "false"); break;
+				case DT_STR:   node_dump_str(node->str_val); break;
+				default:       printf("list"); break;
+			}
+			break;
+		case N_BINOP:
+		case N_UNOP:
+			printf("%s %s", node->type == N_BINOP ? "binop" : "unop",
+			       operator_to_str(node->op));
+			break;
+		case N_VAR_ACCESS:
+			printf("var %s", node->var_name);
+			break;
+		case N_VAR_ASSIGN:
+			printf("assign %s", node->var_name);
+			break;
+		case N_VAR_DEF:
+			printf("def %s: %s", node->var_name, node->var_type_str);
+			break;
+		case N_FUNC_DEF:
+			printf("func %s(", node->func_name);
+			for (int i = 0; i < node->func_params.len; i++) {
+				Node *param = node->func_params.items[i];
+				printf("%s%s: %s", i > 0 ? ", " : "",
+				       param->var_name, param->var_type_str);
+			}
+			printf(") -> %s\n", node->func_ret_type_str);
+			node_dump_all(node->func_statements, depth + 1);
+			return;
+		case N_FUNC_CALL:
+			printf("call");
+			break;
+		case N_GET_ITEM:
+			printf("get_item");
+			break;
+		case N_IF:
+			printf("if\n");
+			for (int i = 0; i < node->conditions.len; i++) {
+				node_dump(node->conditions.items[i], depth + 1);
+				node_dump(node->if_blocks.items[i], depth + 1);
+			}
+			if (node->else_block != NULL) {
+				printf("%*selse\n", (depth + 1) * 2, "");
+				node_dump(node->else_block, depth + 1);
+			}
+			return;
+		case N_ITER:
+			printf("iter as %s", node->loop_iterator_var_name);
+			if (node->loop_with_index)
+				printf(" @ %s", node->loop_index_var_name);
+			break;
+		case N_RETURN:
+			printf("return");
+			break;
+		default:
+			printf("node %d", node->type);
+			break;
+	}
+	if (node->static_type != DT_UNKNOWN && node->type != N_ITER)
+		printf(" <%s>", data_type_to_str(node->static_type));
+	printf("\n");
+
+	int child_depth = depth + 1;
+	node_visit_children(node, node_dump_child, &child_depth);
 }
 
 Node *parser_parse(Parser *parser) {
@@ -81,13 +306,13 @@ Node *parser_parse_arith(Parser *parser) {
 
 	while (parser->current_token.tok_kind == T_PLUS ||
 	       parser->current_token.tok_kind == T_MINUS) {
-		Node *binop_node = init_node();
-		strcpy(binop_node->op_str, parser->current_token.text);
+		Node *binop_node = init_node(parser, N_BINOP);
+		binop_node->op = parser_operator(parser->current_token.tok_kind, 0);
+		binop_node->operand_type = DT_UNKNOWN;
 
 		parser_consume(parser);
 		Node *right = parser_parse_term(parser);
 
-		binop_node->type = N_BINOP;
 		binop_node->left = left;
 		binop_node->right = right;
 		left = binop_node;
@@ -100,39 +325,34 @@ Node *parser_parse_atom(Parser *parser) {
 	tok_kind_t kind = parser->current_token.tok_kind;
 
 	if (kind == T_ID) {
-		if (strcmp(parser->current_token.text, "true") == 0 ||
-		    strcmp(parser->current_token.text, "false") == 0) {
-			Node *val_node = init_node();
-			val_node->type = N_LITERAL;
-			val_node->var_type = DT_BOOL;
-			if (strcmp(parser->current_token.text, "true") == 0) {
-				val_node->bool_val = 1;
-			} else {
-				val_node->bool_val = 0;
-			}
-			parser_consume(parser);
-			return val_node;
-		} 
-
 		/* Parse identifier */
 		return parser_parse_identifier(parser);
+	} else if (kind == T_TRUE || kind == T_FALSE) {
+		Node *val_node = init_node(parser, N_LITERAL);
+		val_node->var_type = DT_BOOL;
+		val_node->bool_val = kind == T_TRUE;
+		parser_consume(parser);
+		return val_node;
 	} else if (kind == T_STR ||
 		   kind == T_INT ||
 		   kind == T_FLOAT) {
 		/* Parse literals */
-		Node *val_node = init_node();
-		val_node->type = N_LITERAL;
-		val_node->value_token = parser->current_token;
+		Node *val_node = init_node(parser, N_LITERAL);
+		Token token = parser->current_token;
+		/* a number is short, its span is copied to be terminated */
+		char text[64];
+		snprintf(text, sizeof(text), "%.*s", token.len,
+		         parser->lexer.source + token.start);
 		if (kind == T_STR) {
 			val_node->var_type = DT_STR;
-			strcpy(val_node->str_val, val_node->value_token.text);
+			val_node->str_val = lexer_token_str(&parser->lexer, token);
 		} else if (kind == T_INT) {
 			val_node->var_type = DT_INT;
-			val_node->int_val = atoi(val_node->value_token.text);
+			val_node->int_val = atoi(text);
 		}
 		else if (kind == T_FLOAT) {
 			val_node->var_type = DT_FLOAT;
-			val_node->float_val = atof(val_node->value_token.text);
+			val_node->float_val = atof(text);
 		}
 		parser_consume(parser);
 		return val_node;
@@ -183,10 +403,10 @@ Node *parser_parse_call(Parser *parser) {
 			parser_consume(parser);
 		}
 
-		Node *obj = init_node();
-		obj->type = N_FUNC_CALL;
-		obj->func_args = args;
+		Node *obj = init_node(parser, N_FUNC_CALL);
+		obj->func_args = parser_node_list(parser, args);
 		obj->callee = atom;
+		obj->line = atom->line;
 		return obj;
 	} else if (parser->current_token.tok_kind == T_LBRACKET) {
 		/* Handle item access */
@@ -198,10 +418,10 @@ Node *parser_parse_call(Parser *parser) {
 			exit(1);
 		}
 		parser_consume(parser);
-		Node *get_item_node = init_node();
-		get_item_node->type = N_GET_ITEM;
+		Node *get_item_node = init_node(parser, N_GET_ITEM);
 		get_item_node->list_node = atom;
 		get_item_node->index_node = index_node;
+		get_item_node->line = atom->line;
 		return get_item_node;
 
 	} else 
@@ -211,13 +431,12 @@ Node *parser_parse_call(Parser *parser) {
 Node *parser_parse_comp(Parser *parser) {
 	// 1) parse NOT
 	if (parser->current_token.tok_kind == T_NOT) {
-		Node *unop_node = init_node();
-		strcpy(unop_node->op_str, parser->current_token.text);
+		Node *unop_node = init_node(parser, N_UNOP);
+		unop_node->op = parser_operator(parser->current_token.tok_kind, 1);
 
 		parser_consume(parser);
 		unop_node->right = parser_parse_comp(parser);
-		
-		unop_node->type = N_UNOP;
+
 		return unop_node;
 	}
 
@@ -231,13 +450,13 @@ Node *parser_parse_comp(Parser *parser) {
 	       parser->current_token.tok_kind == T_GE ||
 	       parser->current_token.tok_kind == T_LE ||
 	       parser->current_token.tok_kind == T_NE) {
-		Node *binop_node = init_node();
-		strcpy(binop_node->op_str, parser->current_token.text);
+		Node *binop_node = init_node(parser, N_BINOP);
+		binop_node->op = parser_operator(parser->current_token.tok_kind, 0);
+		binop_node->operand_type = DT_UNKNOWN;
 
 		parser_consume(parser);
 		Node *right = parser_parse_arith(parser);
 
-		binop_node->type = N_BINOP;
 		binop_node->left = left;
 		binop_node->right = right;
 		left = binop_node;
@@ -252,13 +471,13 @@ Node *parser_parse_expression(Parser *parser) {
 	/* and, or, ... */
 	while (parser->current_token.tok_kind == T_AND ||
 	       parser->current_token.tok_kind == T_OR) {
-		Node *binop_node = init_node();
-		strcpy(binop_node->op_str, parser->current_token.text);
+		Node *binop_node = init_node(parser, N_BINOP);
+		binop_node->op = parser_operator(parser->current_token.tok_kind, 0);
+		binop_node->operand_type = DT_UNKNOWN;
 
 		parser_consume(parser);
 		Node *right = parser_parse_comp(parser);
 
-		binop_node->type = N_BINOP;
 		binop_node->left = left;
 		binop_node->right = right;
 		left = binop_node;
@@ -271,13 +490,12 @@ Node *parser_parse_factor(Parser *parser) {
 	if (parser->current_token.tok_kind == T_MINUS ||
 	    parser->current_token.tok_kind == T_PLUS) {
 		/* Handle unary operator +/- */
-		Node *unop_node = init_node();
-		strcpy(unop_node->op_str, parser->current_token.text);
+		Node *unop_node = init_node(parser, N_UNOP);
+		unop_node->op = parser_operator(parser->current_token.tok_kind, 1);
 
 		parser_consume(parser);
 		unop_node->right = parser_parse_factor(parser);
-		
-		unop_node->type = N_UNOP;
+
 		return unop_node;
 	}
 	Node *left = parser_parse_power(parser);
@@ -321,10 +539,10 @@ Node *parser_parse_function_def(Parser *parser, Token id_token) {
 	parser_consume(parser);
 
 	if ((parser->current_token.tok_kind != T_ID) &&
-	    (parser->current_token.tok_kind != T_KEYWORD)) {
+	    !tok_is_keyword(parser->current_token.tok_kind)) {
 		printf("ERROR: specifcy return type");
 	}
-	parser_consume(parser);
+	Token ret_type_token = parser_consume(parser);
 
 	if (parser->current_token.tok_kind != T_COLON) {
 		printf("ERROR: expected \":\" to define a function.");
@@ -333,33 +551,33 @@ Node *parser_parse_function_def(Parser *parser, Token id_token) {
 	parser_consume(parser);
 
 	/* parse the function body */
-	Node *func_node_def = init_node();
-	while (strcmp(parser->current_token.text, "end") != 0) {
-		if (strcmp(parser->current_token.text, "return") == 0) {
+	Node *func_node_def = init_node(parser, N_FUNC_DEF);
+	Node **func_statements = NULL;
+	while (parser->current_token.tok_kind != T_END) {
+		if (parser->current_token.tok_kind == T_RETURN) {
 			parser_consume(parser);
-			Node *return_node = init_node();
-			return_node->type = N_RETURN;
+			Node *return_node = init_node(parser, N_RETURN);
 			return_node->return_value = 
 				parser_parse_expression(parser);
-			arrput(func_node_def->func_statements, return_node);
+			arrput(func_statements, return_node);
 		} else {
-			arrput(func_node_def->func_statements,
-			       parser_parse_statement(parser));
+			arrput(func_statements, parser_parse_statement(parser));
 		}
 	}
 	parser_consume(parser);
 
-	func_node_def->func_params = func_params;
-	func_node_def->is_builtin = 0;
-	func_node_def->type = N_FUNC_DEF;
-	strcpy(func_node_def->func_name, id_token.text);
+	func_node_def->func_params = parser_node_list(parser, func_params);
+	func_node_def->func_statements = parser_node_list(parser, func_statements);
+	func_node_def->func_name = id_token.name;
+	func_node_def->func_ret_type_str = ret_type_token.name;
+	func_node_def->func_ret_type = data_type_from_str(ret_type_token.name);
+	func_node_def->line = id_token.line_num;
 	return func_node_def;
 }
 
 Node *parser_parse_function_param(Parser *parser) {
-	/* TODO: Treat as variable definition node */
-	Node *param = init_node();
-	strcpy(param->param_name, parser->current_token.text);
+	Node *param = init_node(parser, N_FUNC_PARAM);
+	param->var_name = parser->current_token.name;
 	
 	parser_consume(parser);
 	if (parser->current_token.tok_kind != T_COLON) {
@@ -368,23 +586,22 @@ Node *parser_parse_function_param(Parser *parser) {
 	}
 
 	parser_consume(parser);
-	char *var_type_str = parser->current_token.text;
-	sprintf(param->var_type_str, "%s", var_type_str);
+	param->var_type_str = parser->current_token.name;
+	param->var_decl_type = data_type_from_str(param->var_type_str);
 	parser_consume(parser);
 
 	return param;
 }
 
 Node *parser_parse_block(Parser *parser) {
-	Node *block_node = init_node();
-	block_node->type = N_BLOCK;
-	block_node->block_statements = NULL;
-	while (strcmp(parser->current_token.text, "end") != 0 &&
-	       strcmp(parser->current_token.text, "elif") != 0 &&
-	       strcmp(parser->current_token.text, "else") != 0) {
-		arrput(block_node->block_statements,
-		       parser_parse_statement(parser));
+	Node *block_node = init_node(parser, N_BLOCK);
+	Node **block_statements = NULL;
+	while (parser->current_token.tok_kind != T_END &&
+	       parser->current_token.tok_kind != T_ELIF &&
+	       parser->current_token.tok_kind != T_ELSE) {
+		arrput(block_statements, parser_parse_statement(parser));
 	}
+	block_node->block_statements = parser_node_list(parser, block_statements);
 	return block_node;
 }
 
@@ -402,37 +619,38 @@ Node *parser_parse_identifier(Parser *parser) {
 	if (next_token.tok_kind == T_EQUAL) {
 		/* Handle assignment */
 		parser_consume(parser);
-		Node *var_assign = init_node();
-		var_assign->type = N_VAR_ASSIGN;
+		Node *var_assign = init_node(parser, N_VAR_ASSIGN);
 		var_assign->var_node = parser_parse_expression(parser);
-		strcpy(var_assign->var_name, id_token.text);
+		var_assign->var_name = id_token.name;
 		return var_assign;
 	} else {
 		/* Handle variable access */
-		Node *obj = init_node();
-		obj->type = N_VAR_ACCESS;
-		strcpy(obj->var_name, id_token.text);
+		Node *obj = init_node(parser, N_VAR_ACCESS);
+		obj->var_name = id_token.name;
 		return obj;
 	}
 
 	printf("ERROR: Invalid syntax.\n");
-	printf("%s.\n", parser->current_token.text);
+	printf("%.*s.\n", parser->current_token.len,
+	       parser->lexer.source + parser->current_token.start);
 	exit(1);
 }
 
 Node *parser_parse_if(Parser *parser) {
+	int line = parser->current_token.line_num;
 	parser_consume(parser);
 
 	Node *if_condition_expr = parser_parse_expression(parser);
 	if (parser->current_token.tok_kind != T_COLON) {
-		printf("%s\n", parser->current_token.text);
+		printf("%.*s\n", parser->current_token.len,
+		       parser->lexer.source + parser->current_token.start);
 		printf("ERROR: Expected \":\"");
 		exit(1);
 	}
 	parser_consume(parser);
 
-	Node *if_node = init_node();
-	if_node->type = N_IF;
+	Node *if_node = init_node(parser, N_IF);
+	if_node->line = line;
 
 	Node **conditions = NULL;
 	Node **if_blocks = NULL;
@@ -440,17 +658,17 @@ Node *parser_parse_if(Parser *parser) {
 	arrput(conditions, if_condition_expr);
 	arrput(if_blocks, parser_parse_block(parser));
 
-	if (strcmp(parser->current_token.text, "end") == 0) {
+	if (parser->current_token.tok_kind == T_END) {
 		parser_consume(parser);
 		/* if end keyword present immediately after if statement
 		 * block, then just return the if_node */
-		if_node->conditions = conditions;
-		if_node->if_blocks = if_blocks;
+		if_node->conditions = parser_node_list(parser, conditions);
+		if_node->if_blocks = parser_node_list(parser, if_blocks);
 		return if_node;
 	}
 
-	if (strcmp(parser->current_token.text, "elif") == 0) {
-		while (strcmp(parser->current_token.text, "elif") == 0) {
+	if (parser->current_token.tok_kind == T_ELIF) {
+		while (parser->current_token.tok_kind == T_ELIF) {
 			parser_consume(parser);
 			arrput(conditions, parser_parse_expression(parser));
 			if (parser->current_token.tok_kind != T_COLON) {
@@ -464,15 +682,15 @@ Node *parser_parse_if(Parser *parser) {
 	} 
 
 	/* check whether a series of elif is terminated */
-	if (strcmp(parser->current_token.text, "end") == 0) {
+	if (parser->current_token.tok_kind == T_END) {
 		parser_consume(parser);
-		if_node->conditions = conditions;
-		if_node->if_blocks = if_blocks;
+		if_node->conditions = parser_node_list(parser, conditions);
+		if_node->if_blocks = parser_node_list(parser, if_blocks);
 		return if_node;
 	}
 
 	/* otherwise, if else keyword present, handle it accordingly */
-	if (strcmp(parser->current_token.text, "else") == 0) {
+	if (parser->current_token.tok_kind == T_ELSE) {
 		parser_consume(parser);
 		if (parser->current_token.tok_kind != T_COLON) {
 			printf("ERROR: Expected \":\"");
@@ -482,13 +700,13 @@ Node *parser_parse_if(Parser *parser) {
 		else_block = parser_parse_block(parser);
 	} 
 
-	if (strcmp(parser->current_token.text, "end") != 0) {
+	if (parser->current_token.tok_kind != T_END) {
 		printf("ERROR: Expected \"end\"");
 		exit(1);
 	}
 	parser_consume(parser);
-	if_node->conditions = conditions;
-	if_node->if_blocks = if_blocks;
+	if_node->conditions = parser_node_list(parser, conditions);
+	if_node->if_blocks = parser_node_list(parser, if_blocks);
 	if_node->else_block = else_block;
 
 	return if_node;
@@ -499,14 +717,14 @@ Node *parser_parse_iter(Parser *parser) {
 
 	Node *iterable = parser_parse_expression(parser);
 
-	if (strcmp(parser->current_token.text, "as") != 0) {
+	if (parser->current_token.tok_kind != T_AS) {
 		printf("ERROR: Expected \"as\"");
 		exit(1);
 	}
 	parser_consume(parser);
 
-	Node *iter_node = init_node();
-	strcpy(iter_node->loop_iterator_var_name, parser->current_token.text);
+	Node *iter_node = init_node(parser, N_ITER);
+	iter_node->loop_iterator_var_name = parser->current_token.name;
 
 	parser_consume(parser);
 
@@ -522,7 +740,7 @@ Node *parser_parse_iter(Parser *parser) {
 			exit(1);
 		}
 		iter_node->loop_with_index = 1;
-		strcpy(iter_node->loop_index_var_name, parser->current_token.text);
+		iter_node->loop_index_var_name = parser->current_token.name;
 		parser_consume(parser);
 
 		if (parser->current_token.tok_kind != T_COLON) {
@@ -535,13 +753,12 @@ Node *parser_parse_iter(Parser *parser) {
 	}
 
 	Node **loop_statements = NULL;
-	while (strcmp(parser->current_token.text, "end") != 0) {
+	while (parser->current_token.tok_kind != T_END) {
 		arrput(loop_statements, parser_parse_statement(parser));
 	}
 	parser_consume(parser); // consume "end" token
 
-	iter_node->type = N_ITER;
-	iter_node->loop_statements = loop_statements;
+	iter_node->loop_statements = parser_node_list(parser, loop_statements);
 	iter_node->iterable = iterable;
 
 	return iter_node;
@@ -549,7 +766,7 @@ Node *parser_parse_iter(Parser *parser) {
 
 Node *parser_parse_list(Parser *parser) {
 	parser_consume(parser);
-	Node *obj = init_node();
+	Node *obj = init_node(parser, N_LITERAL);
 	Node **list_items = NULL;
 	if (parser->current_token.tok_kind == T_RBRACKET) {
 		parser_consume(parser);
@@ -568,9 +785,8 @@ Node *parser_parse_list(Parser *parser) {
 		}
 		parser_consume(parser);
 	}
-	obj->type = N_LITERAL;
 	obj->var_type = DT_LIST;
-	obj->list_items = list_items;
+	obj->list_items = parser_node_list(parser, list_items);
 	return obj;
 }
 
@@ -587,19 +803,21 @@ Node *parser_parse_script(Parser *parser) {
 		arrput(statements, stmt);
 	}
 
-	Node *list_node = init_node();
-	list_node->type = N_STATEMENTS;
-	list_node->list_items = statements;
+	Node *list_node = init_node(parser, N_STATEMENTS);
+	list_node->statements = parser_node_list(parser, statements);
+	list_node->arena = parser->arena;
+	list_node->layouts = NULL;
+	parser->arena = NULL;
 	return list_node;
 }
 
 Node *parser_parse_statement(Parser *parser) {
-	if (strcmp(parser->current_token.text, "iter") == 0) {
+	if (parser->current_token.tok_kind == T_ITER) {
 		return parser_parse_iter(parser);
-	} else if (strcmp(parser->current_token.text, "if") == 0) {
+	} else if (parser->current_token.tok_kind == T_IF) {
 		return parser_parse_if(parser);
 	} else if (parser->current_token.tok_kind == T_ID) {
-		Token next_token = parser->lexer.tokens[parser->i+1];
+		Token next_token = parser_lookahed(parser);
 		if (next_token.tok_kind == T_COLON) {
 			Token id_token = parser->current_token;
 			parser_consume(parser); // leaving ID
@@ -609,7 +827,7 @@ Node *parser_parse_statement(Parser *parser) {
 			Token data_type_token = parser_consume(parser);
 
 			/* Handle function definition */
-			if (strcmp(data_type_token.text, "func") == 0) {
+			if (data_type_token.tok_kind == T_FUNC) {
 				return parser_parse_function_def(parser, id_token);
 			}
 
@@ -620,19 +838,13 @@ Node *parser_parse_statement(Parser *parser) {
 				 */
 				parser_consume(parser);
 
-				Node *vardef_node = init_node();
-				vardef_node->type = N_VAR_DEF;
+				Node *vardef_node = init_node(parser, N_VAR_DEF);
 				Node *var_node = parser_parse_expression(parser);
 				vardef_node->var_node = var_node;
-				strcpy(vardef_node->var_name, id_token.text);
-				strcpy(vardef_node->var_type_str, data_type_token.text);
-				if (strcmp(data_type_token.text, "str") == 0) {
-					vardef_node->var_type = DT_STR;
-				} else if (strcmp(data_type_token.text, "int") == 0) {
-					vardef_node->var_type = DT_INT;
-				} else if (strcmp(data_type_token.text, "float") == 0) {
-					vardef_node->var_type = DT_FLOAT;
-				}
+				vardef_node->var_name = id_token.name;
+				vardef_node->var_type_str = data_type_token.name;
+				vardef_node->var_decl_type =
+					data_type_from_str(data_type_token.name);
 
 				return vardef_node;
 			} 
@@ -646,13 +858,13 @@ Node *parser_parse_term(Parser *parser) {
 
 	while (parser->current_token.tok_kind == T_MULT ||
 	       parser->current_token.tok_kind == T_DIV) {
-		Node *binop_node = init_node();
-		strcpy(binop_node->op_str, parser->current_token.text);
+		Node *binop_node = init_node(parser, N_BINOP);
+		binop_node->op = parser_operator(parser->current_token.tok_kind, 0);
+		binop_node->operand_type = DT_UNKNOWN;
 
 		parser_consume(parser);
 		Node *right = parser_parse_factor(parser);
 
-		binop_node->type = N_BINOP;
 		binop_node->left = left;
 		binop_node->right = right;
 		left = binop_node;
@@ -665,63 +877,6 @@ Node *parser_parse_value(Parser *parser) {
 	exit(1);
 }
 
-Node *parser_parse_variable_def(Parser *parser,
-		                    Token id_token,
-		                    char *var_type_str, 
-				    Token var_value_token,
-				    int initialized) {
-	Node *obj = init_node();
-	obj->type = N_VAR_DEF;
-	strcpy(obj->var_name, id_token.text);
-	
-	if (strcmp(var_type_str, "str") == 0) {
-		obj->var_type = DT_STR;
-		if (initialized) strcpy(obj->str_val, var_value_token.text);
-		else strcpy(obj->str_val, "");
-	} else if (strcmp(var_type_str, "int") == 0) {
-		obj->var_type = DT_INT;
-		if (initialized) obj->int_val = atoi(var_value_token.text);
-		else obj->int_val = 0;
-	} else if (strcmp(var_type_str, "float") == 0) {
-		obj->var_type = DT_FLOAT;
-		if (initialized) obj->float_val = atof(var_value_token.text);
-		else obj->float_val = 0.0;
-	}  else if (strcmp(var_type_str, "null") == 0) {
-		obj->var_type = DT_NULL;
-	} else if (strcmp(var_type_str, "list") == 0) {
-		if (parser->current_token.tok_kind != T_LBRACKET) {
-			printf("[ expected");
-			exit(1);
-		}
-		parser_consume(parser);
-
-		obj->var_type = DT_LIST;
-		Node **list_items = NULL;
-		if (parser->current_token.tok_kind == T_RBRACKET) {
-			parser_consume(parser);
-		} else {
-			Node *item = parser_parse_expression(parser);
-			arrput(list_items, item);
-			while (parser->current_token.tok_kind == T_COMMA) {
-				parser_consume(parser);
-				Node *item = parser_parse_expression(parser);
-				arrput(list_items, item);
-			}
-
-			if (parser->current_token.tok_kind != T_RBRACKET) {
-				printf("] expected");
-			}
-
-			parser_consume(parser);
-		}
-		obj->list_items = list_items;
-	} else {
-		printf("ERROR: unknown data type: %s\n", var_type_str);
-		exit(1);
-	}
-	return obj;
-}
-
 int carrot_get_args_len(Node *args) {
 	return arrlen(args);
 }
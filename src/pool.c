@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/pool.h"
+#include "../include/stats.h"
+
+/* Blocks of the free lists are poisoned for AddressSanitizer, so that
+ * a use after free is still reported */
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define POOL_POISON(ptr, size)   ASAN_POISON_MEMORY_REGION(ptr, size)
+#define POOL_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#define POOL_POISON(ptr, size)   ((void) 0)
+#define POOL_UNPOISON(ptr, size) ((void) 0)
+#endif
+
+typedef struct POOL_SLAB {
+	struct POOL_SLAB *next;
+	char             data[];
+} PoolSlab;
+
+typedef struct POOL_BLOCK {
+	struct POOL_BLOCK *next;   // only while in the free list
+} PoolBlock;
+
+/* Header of the blocks of the malloc-like interface, keeps the blocks
+ * aligned like malloc() would */
+typedef struct POOL_HEADER {
+	size_t size;
+	size_t pad;
+} PoolHeader;
+
+typedef struct POOL_CLASS {
+	PoolBlock *free_list;
+	char      *bump;       // next unused block of the current slab
+	char      *bump_end;
+} PoolClass;
+
+PoolStats CARROT_POOL_STATS;
+
+static PoolClass pool_classes[POOL_CLASS_NUM];
+static PoolSlab  *pool_slabs = NULL;
+
+static inline int pool_class(size_t size) {
+	return size == 0 ? 0 : (size - 1) / POOL_GRANULARITY;
+}
+
+static void pool_new_slab(PoolClass *cls) {
+	PoolSlab *slab = malloc(sizeof(PoolSlab) + POOL_SLAB_SIZE);
+	if (slab == NULL) {
+		printf("ERROR: Out of memory\n");
+		exit(1);
+	}
+	slab->next = pool_slabs;
+	pool_slabs = slab;
+	cls->bump = slab->data;
+	cls->bump_end = slab->data + POOL_SLAB_SIZE;
+	POOL_POISON(slab->data, POOL_SLAB_SIZE);
+	CARROT_POOL_STATS.slabs++;
+}
+
+void *carrot_pool_alloc(size_t size) {
+	/* Returns uninitialized memory */
+	if (size > POOL_MAX_SIZE) {
+		void *mem = malloc(size);
+		if (mem == NULL) {
+			printf("ERROR: Out of memory\n");
+			exit(1);
+		}
+		CARROT_POOL_STATS.large++;
+		return mem;
+	}
+
+	int idx = pool_class(size);
+	size_t block_size = (idx + 1) * POOL_GRANULARITY;
+	PoolClass *cls = &pool_classes[idx];
+	CARROT_POOL_STATS.allocs++;
+
+	PoolBlock *block = cls->free_list;
+	if (block != NULL) {
+		POOL_UNPOISON(block, block_size);
+		cls->free_list = block->next;
+		CARROT_POOL_STATS.reused++;
+		return block;
+	}
+
+	if (cls->bump + block_size > cls->bump_end) pool_new_slab(cls);
+	void *mem = cls->bump;
+	cls->bump += block_size;
+	POOL_UNPOISON(mem, block_size);
+	return mem;
+}
+
+void *carrot_pool_calloc(size_t size) {
+	void *mem = carrot_pool_alloc(size);
+	memset(mem, 0, size);
+	return mem;
+}
+
+void carrot_pool_free(void *ptr, size_t size) {
+	if (ptr == NULL) return;
+	if (size > POOL_MAX_SIZE) {
+		free(ptr);
+		return;
+	}
+
+	int idx = pool_class(size);
+	PoolClass *cls = &pool_classes[idx];
+	PoolBlock *block = ptr;
+	block->next = cls->free_list;
+	cls->free_list = block;
+	POOL_POISON(block, (idx + 1) * POOL_GRANULARITY);
+	CARROT_POOL_STATS.frees++;
+}
+
+void *carrot_pool_malloc(size_t size) {
+	PoolHeader *header = carrot_pool_alloc(sizeof(PoolHeader) + size);
+	header->size = size;
+	return header + 1;
+}
+
+void *carrot_pool_realloc(void *ptr, size_t size) {
+	if (ptr == NULL) return carrot_pool_malloc(size);
+
+	PoolHeader *header = (PoolHeader *) ptr - 1;
+	size_t old_total = sizeof(PoolHeader) + header->size;
+	size_t new_total = sizeof(PoolHeader) + size;
+	if (old_total > POOL_MAX_SIZE && new_total > POOL_MAX_SIZE) {
+		PoolHeader *grown = realloc(header, new_total);
+		if (grown == NULL) {
+			printf("ERROR: Out of memory\n");
+			exit(1);
+		}
+		grown->size = size;
+		return grown + 1;
+	}
+	if (old_total <= POOL_MAX_SIZE && new_total <= POOL_MAX_SIZE &&
+	    pool_class(old_total) == pool_class(new_total)) {
+		/* the block has room already */
+		header->size = size;
+		return ptr;
+	}
+
+	void *moved = carrot_pool_malloc(size);
+	memcpy(moved, ptr, header->size < size ? header->size : size);
+	carrot_pool_release(ptr);
+	return moved;
+}
+
+void carrot_pool_release(void *ptr) {
+	if (ptr == NULL) return;
+	PoolHeader *header = (PoolHeader *) ptr - 1;
+	carrot_pool_free(header, sizeof(PoolHeader) + header->size);
+}
+
+void carrot_pool_finalize() {
+	PoolSlab *slab = pool_slabs;
+	while (slab != NULL) {
+		PoolSlab *next = slab->next;
+		POOL_UNPOISON(slab->data, POOL_SLAB_SIZE);
+		free(slab);
+		slab = next;
+	}
+	pool_slabs = NULL;
+	memset(pool_classes, 0, sizeof(pool_classes));
+}
@@ -0,0 +1,161 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "../include/profiler.h"
+
+ProfileStack CARROT_PROFILE_STACK = {{{"<script>", 0}}, 1};
+
+/* The samples are aggregated by the signal handler, which cannot
+ * allocate: the distinct stacks go into a fixed size hash table and
+ * their frames into a fixed size pool. Samples that do not fit are
+ * dropped and counted. */
+#define PROFILER_TABLE_SIZE  16384     // power of 2, half of it is used
+#define PROFILER_POOL_FRAMES (1 << 18)
+
+typedef struct PROFILE_ENTRY {
+	unsigned long hash;
+	int           offset;   // first frame in the pool
+	int           depth;
+	long          count;    // 0 if the entry is free
+} ProfileEntry;
+
+static ProfileEntry *profile_table = NULL;
+static ProfileFrame *profile_pool = NULL;
+static int          profile_pool_used = 0;
+static int          profile_stacks = 0;
+static long         profile_dropped = 0;
+static char         *profile_filename = NULL;
+
+static carrot_profile_walker_t profile_walker = NULL;
+static void                    *profile_walker_data = NULL;
+
+void carrot_profile_set_walker(carrot_profile_walker_t walker, void *data) {
+	/* NULL goes back to CARROT_PROFILE_STACK */
+	profile_walker_data = data;
+	atomic_signal_fence(memory_order_release);
+	profile_walker = walker;
+}
+
+static unsigned long profile_hash(ProfileFrame *frames, int depth) {
+	/* FNV-1a of the names and lines */
+	unsigned long hash = 14695981039346656037UL;
+	for (int i = 0; i < depth; i++) {
+		hash = (hash ^ (unsigned long) frames[i].name) * 1099511628211UL;
+		hash = (hash ^ (unsigned long) frames[i].line) * 1099511628211UL;
+	}
+	return hash;
+}
+
+static int profile_same_stack(ProfileEntry *entry, ProfileFrame *frames, int depth) {
+	if (entry->depth != depth) return 0;
+	ProfileFrame *stored = &profile_pool[entry->offset];
+	for (int i = 0; i < depth; i++) {
+		if (stored[i].name != frames[i].name || stored[i].line != frames[i].line)
+			return 0;
+	}
+	return 1;
+}
+
+static void profile_record(ProfileFrame *frames, int depth) {
+	unsigned long hash = profile_hash(frames, depth);
+	int idx = hash & (PROFILER_TABLE_SIZE - 1);
+	while (profile_table[idx].count > 0) {
+		ProfileEntry *entry = &profile_table[idx];
+		if (entry->hash == hash && profile_same_stack(entry, frames, depth)) {
+			entry->count++;
+			return;
+		}
+		idx = (idx + 1) & (PROFILER_TABLE_SIZE - 1);
+	}
+
+	if (profile_stacks >= PROFILER_TABLE_SIZE / 2 ||
+	    profile_pool_used + depth > PROFILER_POOL_FRAMES) {
+		profile_dropped++;
+		return;
+	}
+	ProfileEntry *entry = &profile_table[idx];
+	entry->hash = hash;
+	entry->offset = profile_pool_used;
+	entry->depth = depth;
+	entry->count = 1;
+	memcpy(&profile_pool[profile_pool_used], frames, depth * sizeof(ProfileFrame));
+	profile_pool_used += depth;
+	profile_stacks++;
+}
+
+static void profile_handler(int sig) {
+	(void) sig;
+	ProfileFrame frames[PROFILER_MAX_DEPTH];
+	int depth;
+	if (profile_walker != NULL) {
+		depth = profile_walker(profile_walker_data, frames, PROFILER_MAX_DEPTH);
+	} else {
+		depth = CARROT_PROFILE_STACK.depth;
+		if (depth > PROFILER_MAX_DEPTH) depth = PROFILER_MAX_DEPTH;
+		memcpy(frames, CARROT_PROFILE_STACK.frames, depth * sizeof(ProfileFrame));
+	}
+	profile_record(frames, depth);
+}
+
+void carrot_profile_start(char *filename, int interval) {
+	profile_table = calloc(PROFILER_TABLE_SIZE, sizeof(ProfileEntry));
+	profile_pool = malloc(PROFILER_POOL_FRAMES * sizeof(ProfileFrame));
+	profile_filename = filename;
+	/* the samples are also written when the script exits on an error */
+	atexit(carrot_profile_stop);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = profile_handler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGPROF, &action, NULL);
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = interval / 1000000;
+	timer.it_interval.tv_usec = interval % 1000000;
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+static void profile_write(FILE *out) {
+	for (int i = 0; i < PROFILER_TABLE_SIZE; i++) {
+		ProfileEntry *entry = &profile_table[i];
+		if (entry->count == 0) continue;
+		ProfileFrame *frames = &profile_pool[entry->offset];
+		for (int j = 0; j < entry->depth; j++) {
+			fprintf(out, j > 0 ? ";%s" : "%s", frames[j].name);
+			if (frames[j].line > 0) fprintf(out, ":%d", frames[j].line);
+		}
+		fprintf(out, " %ld\n", entry->count);
+	}
+}
+
+void carrot_profile_stop() {
+	/* Writes the samples, does nothing if the profiler is not running */
+	if (profile_table == NULL) return;
+
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	signal(SIGPROF, SIG_IGN);
+
+	FILE *out = fopen(profile_filename, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Could not write the profile to '%s'\n", profile_filename);
+	} else {
+		profile_write(out);
+		fclose(out);
+	}
+	if (profile_dropped > 0) {
+		fprintf(stderr, "profiler: %ld samples dropped, too many distinct stacks\n",
+		        profile_dropped);
+	}
+
+	free(profile_table);
+	free(profile_pool);
+	profile_table = NULL;
+	profile_pool = NULL;
+}
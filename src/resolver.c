@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/resolver.h"
+#include "../lib/include/stb_ds.h"
+
+static void resolver_visit(void *data, Node *node);
+
+static ScopeLayout *scope_layout_new(Resolver *resolver) {
+	/* Layouts are released along with the script, see free_node() */
+	Node *script = resolver->script;
+	ScopeLayout *layout = arena_alloc(script->arena, sizeof(ScopeLayout));
+	layout->slots = NULL;
+	arrput(script->layouts, layout);
+	return layout;
+}
+
+static int scope_layout_declare(ScopeLayout *layout, char *name) {
+	ptrdiff_t idx = hmgeti(layout->slots, name);
+	if (idx >= 0) return layout->slots[idx].value;
+
+	int slot = hmlen(layout->slots);
+	hmput(layout->slots, name, slot);
+	return slot;
+}
+
+static void resolver_declare(void *data, Node *node) {
+	/* Declares the names bound by node in the current scope. Function
+	 * and iter bodies have scopes of their own, so they are skipped */
+	ScopeLayout *layout = data;
+	switch (node->type) {
+		case N_VAR_DEF:
+		case N_VAR_ASSIGN:
+			scope_layout_declare(layout, node->var_name);
+			break;
+		case N_FUNC_DEF:
+			scope_layout_declare(layout, node->func_name);
+			return;
+		case N_ITER:
+			resolver_declare(data, node->iterable);
+			return;
+		default:
+			break;
+	}
+	node_visit_children(node, resolver_declare, data);
+}
+
+static void resolver_open_scope(Resolver *resolver,
+		                ScopeLayout *layout,
+		                NodeList statements) {
+	/* Every name bound anywhere in the scope gets its slot up front. A
+	 * slot that is read before it is bound falls back to the lookup by
+	 * name, which keeps the scoping rules of the tree-walking days. */
+	for (int i = 0; i < statements.len; i++) {
+		resolver_declare(layout, statements.items[i]);
+	}
+	arrput(resolver->scopes, layout);
+}
+
+static void resolver_lookup(Resolver *resolver, Node *node) {
+	int top = arrlen(resolver->scopes) - 1;
+	int bottom = resolver->function_base > 0 ? resolver->function_base : 1;
+
+	for (int i = top; i >= bottom; i--) {
+		ptrdiff_t idx = hmgeti(resolver->scopes[i]->slots, node->var_name);
+		if (idx >= 0) {
+			node->var_resolution = RES_LOCAL;
+			node->var_depth = top - i;
+			node->var_slot = resolver->scopes[i]->slots[idx].value;
+			return;
+		}
+	}
+
+	ptrdiff_t idx = hmgeti(resolver->scopes[0]->slots, node->var_name);
+	if (idx >= 0) {
+		node->var_resolution = RES_GLOBAL;
+		node->var_slot = resolver->scopes[0]->slots[idx].value;
+		/* checked once every scope is known, see resolver_shadow() */
+		if (resolver->function_base > 0) arrput(resolver->global_refs, node);
+		return;
+	}
+	node->var_resolution = RES_DYNAMIC;
+}
+
+static void resolver_bind(Resolver *resolver, Node *node, char *name) {
+	/* Definitions and assignments always bind in the current scope */
+	ScopeLayout *layout = resolver->scopes[arrlen(resolver->scopes) - 1];
+	node->var_resolution = RES_LOCAL;
+	node->var_depth = 0;
+	node->var_slot = hmget(layout->slots, name);
+}
+
+static void resolver_visit_func_def(Resolver *resolver, Node *node) {
+	resolver_bind(resolver, node, node->func_name);
+
+	/* Parameters take the first slots, in order */
+	ScopeLayout *layout = scope_layout_new(resolver);
+	for (int i = 0; i < node->func_params.len; i++) {
+		scope_layout_declare(layout, node->func_params.items[i]->var_name);
+	}
+	node->scope_layout = layout;
+
+	int function_base = resolver->function_base;
+	resolver_open_scope(resolver, layout, node->func_statements);
+	resolver->function_base = arrlen(resolver->scopes) - 1;
+	for (int i = 0; i < node->func_statements.len; i++) {
+		resolver_visit(resolver, node->func_statements.items[i]);
+	}
+	arrpop(resolver->scopes);
+	resolver->function_base = function_base;
+}
+
+static void resolver_visit_iter(Resolver *resolver, Node *node) {
+	resolver_visit(resolver, node->iterable);
+
+	ScopeLayout *layout = scope_layout_new(resolver);
+	node->loop_iterator_slot = scope_layout_declare(layout,
+	                                                node->loop_iterator_var_name);
+	if (node->loop_with_index)
+		node->loop_index_slot = scope_layout_declare(layout,
+		                                             node->loop_index_var_name);
+	node->scope_layout = layout;
+
+	resolver_open_scope(resolver, layout, node->loop_statements);
+	for (int i = 0; i < node->loop_statements.len; i++) {
+		resolver_visit(resolver, node->loop_statements.items[i]);
+	}
+	arrpop(resolver->scopes);
+}
+
+static void resolver_visit(void *data, Node *node) {
+	Resolver *resolver = data;
+	switch (node->type) {
+		case N_VAR_ACCESS:
+			resolver_lookup(resolver, node);
+			return;
+		case N_VAR_DEF:
+		case N_VAR_ASSIGN:
+			resolver_visit(resolver, node->var_node);
+			resolver_bind(resolver, node, node->var_name);
+			return;
+		case N_FUNC_DEF:
+			resolver_visit_func_def(resolver, node);
+			return;
+		case N_ITER:
+			resolver_visit_iter(resolver, node);
+			return;
+		default:
+			node_visit_children(node, resolver_visit, resolver);
+	}
+}
+
+static void resolver_shadow(Resolver *resolver) {
+	/* A function sees the locals of its callers, which come before the
+	 * globals. The globals read by functions whose name is bound by any
+	 * function or loop scope are looked up by name. */
+	Node *script = resolver->script;
+	for (int i = 0; i < arrlen(resolver->global_refs); i++) {
+		Node *node = resolver->global_refs[i];
+		for (int j = 1; j < arrlen(script->layouts); j++) {
+			if (hmgeti(script->layouts[j]->slots, node->var_name) >= 0) {
+				node->var_resolution = RES_DYNAMIC;
+				break;
+			}
+		}
+	}
+}
+
+/*===========================================================================
+ * Name resolution
+ *===========================================================================*/
+void resolver_resolve(Node *script, Interpreter *globals) {
+	Resolver resolver;
+	resolver.scopes = NULL;
+	resolver.function_base = 0;
+	resolver.global_refs = NULL;
+	resolver.script = script;
+
+	ScopeLayout *layout = scope_layout_new(&resolver);
+	for (int i = 0; i < hmlen(globals->sym_table); i++) {
+		scope_layout_declare(layout, globals->sym_table[i].key);
+	}
+	script->scope_layout = layout;
+
+	resolver_open_scope(&resolver, layout, script->statements);
+	for (int i = 0; i < script->statements.len; i++) {
+		resolver_visit(&resolver, script->statements.items[i]);
+	}
+	resolver_shadow(&resolver);
+	arrfree(resolver.global_refs);
+	arrfree(resolver.scopes);
+
+	interpreter_use_layout(globals, layout);
+}
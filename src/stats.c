@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "../include/stats.h"
+#include "../include/pool.h"
+
+CarrotStats CARROT_STATS;
+
+/* Counters of the stb_ds implementation, compiled with STBDS_STATISTICS
+ * in parser.c */
+extern size_t stbds_array_grow;
+extern size_t stbds_hash_grow;
+extern size_t stbds_hash_shrink;
+extern size_t stbds_hash_rebuild;
+
+static void stats_count_sds(size_t size) {
+	CARROT_STATS.sds_allocs++;
+	CARROT_STATS.sds_bytes += size;
+	if (size > CARROT_STATS.sds_largest) CARROT_STATS.sds_largest = size;
+}
+
+void *carrot_sds_malloc(size_t size) {
+	stats_count_sds(size);
+	return carrot_pool_malloc(size);
+}
+
+void *carrot_sds_realloc(void *ptr, size_t size) {
+	stats_count_sds(size);
+	return carrot_pool_realloc(ptr, size);
+}
+
+void carrot_sds_free(void *ptr) {
+	carrot_pool_release(ptr);
+}
+
+static long stats_peak_rss() {
+	/* Peak resident set size in KiB. VmHWM only covers the memory of
+	 * this program, ru_maxrss also covers the one of the process that
+	 * forked it before exec. */
+	FILE *status = fopen("/proc/self/status", "r");
+	if (status != NULL) {
+		char line[256];
+		long peak = -1;
+		while (fgets(line, sizeof(line), status) != NULL) {
+			if (strncmp(line, "VmHWM:", 6) == 0) {
+				peak = atol(line + 6);
+				break;
+			}
+		}
+		fclose(status);
+		if (peak >= 0) return peak;
+	}
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/* Only the heap types are allocated, a range is counted apart from the
+ * lists */
+static const carrot_dtype_t stats_obj_types[] = {
+	CARROT_STR, CARROT_LIST, CARROT_RANGE, CARROT_FUNCTION,
+};
+static const char *stats_obj_names[] = {
+	"str", "list", "range", "function",
+};
+#define STATS_OBJ_TYPES_NUM 4
+
+void carrot_stats_print(int json) {
+	CarrotStats *s = &CARROT_STATS;
+	size_t objects = 0;
+	for (int i = 0; i < STATS_OBJ_TYPES_NUM; i++) {
+		objects += s->objects[stats_obj_types[i]];
+	}
+
+	if (json) {
+		fprintf(stderr, "{\n  \"objects\": {");
+		for (int i = 0; i < STATS_OBJ_TYPES_NUM; i++) {
+			fprintf(stderr, "%s\"%s\": %zu", i > 0 ? ", " : "",
+			        stats_obj_names[i], s->objects[stats_obj_types[i]]);
+		}
+		fprintf(stderr, "},\n");
+		fprintf(stderr, "  \"objects_total\": %zu,\n", objects);
+		fprintf(stderr, "  \"objects_peak_live\": %zu,\n", s->objects_peak);
+		fprintf(stderr, "  \"objects_released\": %zu,\n", s->objects_released);
+		fprintf(stderr, "  \"bytes_allocated\": %zu,\n", s->bytes_allocated);
+		fprintf(stderr, "  \"collections\": %zu,\n", s->collections);
+		fprintf(stderr, "  \"sds_allocs\": %zu,\n", s->sds_allocs);
+		fprintf(stderr, "  \"sds_bytes\": %zu,\n", s->sds_bytes);
+		fprintf(stderr, "  \"sds_largest\": %zu,\n", s->sds_largest);
+		fprintf(stderr, "  \"nodes\": %zu,\n", s->nodes);
+		fprintf(stderr, "  \"pool_slabs\": %zu,\n", CARROT_POOL_STATS.slabs);
+		fprintf(stderr, "  \"pool_allocs\": %zu,\n", CARROT_POOL_STATS.allocs);
+		fprintf(stderr, "  \"pool_reused\": %zu,\n", CARROT_POOL_STATS.reused);
+		fprintf(stderr, "  \"pool_frees\": %zu,\n", CARROT_POOL_STATS.frees);
+		fprintf(stderr, "  \"pool_large\": %zu,\n", CARROT_POOL_STATS.large);
+		fprintf(stderr, "  \"array_grows\": %zu,\n", stbds_array_grow);
+		fprintf(stderr, "  \"hash_grows\": %zu,\n", stbds_hash_grow);
+		fprintf(stderr, "  \"hash_shrinks\": %zu,\n", stbds_hash_shrink);
+		fprintf(stderr, "  \"hash_rebuilds\": %zu,\n", stbds_hash_rebuild);
+		fprintf(stderr, "  \"peak_rss_kb\": %ld\n}\n", stats_peak_rss());
+		return;
+	}
+
+	fprintf(stderr, "objects allocated   %zu (", objects);
+	for (int i = 0; i < STATS_OBJ_TYPES_NUM; i++) {
+		fprintf(stderr, "%s%s %zu", i > 0 ? ", " : "",
+		        stats_obj_names[i], s->objects[stats_obj_types[i]]);
+	}
+	fprintf(stderr, ")\n");
+	fprintf(stderr, "peak live objects   %zu\n", s->objects_peak);
+	fprintf(stderr, "released early      %zu (by reference counting)\n",
+	        s->objects_released);
+	fprintf(stderr, "bytes allocated     %zu\n", s->bytes_allocated);
+	fprintf(stderr, "collections         %zu\n", s->collections);
+	fprintf(stderr, "sds allocations     %zu (%zu bytes, largest %zu)\n",
+	        s->sds_allocs, s->sds_bytes, s->sds_largest);
+	fprintf(stderr, "nodes               %zu\n", s->nodes);
+	fprintf(stderr, "pool                %zu allocations (%zu reused), %zu frees, "
+	        "%zu large, %zu slabs\n",
+	        CARROT_POOL_STATS.allocs, CARROT_POOL_STATS.reused,
+	        CARROT_POOL_STATS.frees, CARROT_POOL_STATS.large,
+	        CARROT_POOL_STATS.slabs);
+	fprintf(stderr, "stb_ds resizes      %zu array grows, %zu hash grows, "
+	        "%zu hash shrinks, %zu hash rebuilds\n",
+	        stbds_array_grow, stbds_hash_grow, stbds_hash_shrink,
+	        stbds_hash_rebuild);
+	fprintf(stderr, "peak RSS            %ld KiB\n", stats_peak_rss());
+}
@@ -0,0 +1,380 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/typecheck.h"
+#include "../include/builtin_func.h"
+#include "../lib/include/stb_ds.h"
+
+static data_type_t typecheck_visit(TypeChecker *checker, Node *node);
+
+static void typecheck_error(Node *node, char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	printf("ERROR: line %d: ", node->line);
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+	exit(1);
+}
+
+static StaticVar static_var(data_type_t type) {
+	StaticVar var = {type, DT_UNKNOWN, NULL};
+	return var;
+}
+
+/*===========================================================================
+ * Type environments
+ *===========================================================================*/
+static TypeEnv *type_env_copy(TypeEnv *env) {
+	TypeEnv *copy = NULL;
+	for (int i = 0; i < hmlen(env); i++) {
+		hmput(copy, env[i].key, env[i].value);
+	}
+	return copy;
+}
+
+static TypeEnv *type_env_merge(TypeEnv **branches) {
+	/* Keeps what holds at the end of every branch */
+	TypeEnv *merged = NULL;
+	TypeEnv *first = branches[0];
+	for (int i = 0; i < hmlen(first); i++) {
+		StaticVar var = first[i].value;
+		int bound = 1;
+		for (int j = 1; j < arrlen(branches) && bound; j++) {
+			ptrdiff_t idx = hmgeti(branches[j], first[i].key);
+			if (idx < 0 || branches[j][idx].value.type != var.type) {
+				bound = 0;
+				break;
+			}
+			StaticVar other = branches[j][idx].value;
+			if (other.ret_type != var.ret_type) var.ret_type = DT_UNKNOWN;
+			if (other.func_def != var.func_def) var.func_def = NULL;
+		}
+		if (bound) hmput(merged, first[i].key, var);
+	}
+	return merged;
+}
+
+static TypeEnv **typecheck_current(TypeChecker *checker) {
+	return &checker->scopes[arrlen(checker->scopes) - 1];
+}
+
+static void typecheck_bind(TypeChecker *checker, char *name, StaticVar var) {
+	/* Definitions and assignments always bind in the current scope. A
+	 * binding of unknown type leaves nothing known about the name. */
+	TypeEnv **env = typecheck_current(checker);
+	if (var.type == DT_UNKNOWN)
+		(void) hmdel(*env, name);
+	else
+		hmput(*env, name, var);
+}
+
+static StaticVar *typecheck_lookup(TypeChecker *checker, Node *node) {
+	/* Only the variables of the enclosing function (or of the script
+	 * when outside functions) have a known binding at this point */
+	int top = arrlen(checker->scopes) - 1;
+	TypeEnv *env = NULL;
+	if (node->var_resolution == RES_LOCAL)
+		env = checker->scopes[top - node->var_depth];
+	else if (node->var_resolution == RES_GLOBAL && checker->function_base == 0)
+		env = checker->scopes[0];
+	if (env == NULL) return NULL;
+
+	ptrdiff_t idx = hmgeti(env, node->var_name);
+	return idx >= 0 ? &env[idx].value : NULL;
+}
+
+/*===========================================================================
+ * Expressions
+ *===========================================================================*/
+static carrot_dtype_t typecheck_runtime_type(data_type_t type) {
+	switch (type) {
+		case DT_STR:   return CARROT_STR;
+		case DT_INT:   return CARROT_INT;
+		case DT_FLOAT: return CARROT_FLOAT;
+		case DT_BOOL:  return CARROT_BOOL;
+		case DT_LIST:  return CARROT_LIST;
+		case DT_NULL:  return CARROT_NULL;
+		default:       return CARROT_FUNCTION;
+	}
+}
+
+static data_type_t typecheck_binop(Node *node, data_type_t left, data_type_t right) {
+	operator_t op = node->op;
+	int arith = op == OPR_ADD || op == OPR_SUBTRACT ||
+	            op == OPR_MULT || op == OPR_DIV;
+
+	if (left == DT_UNKNOWN || right == DT_UNKNOWN)
+		return arith ? DT_UNKNOWN : DT_BOOL;
+
+	carrot_dtype_t left_type = typecheck_runtime_type(left);
+	carrot_dtype_t right_type = typecheck_runtime_type(right);
+	if (CARROT_BINOPS[left_type][right_type][op] == NULL) {
+		typecheck_error(node, "operator %s is not defined for type %s and %s",
+		                operator_to_str(op), data_type_to_str(left),
+		                data_type_to_str(right));
+	}
+
+	if ((left == DT_INT || left == DT_FLOAT) && left == right)
+		node->operand_type = left;
+	if (!arith) return DT_BOOL;
+
+	/* Same result types as the handlers of CARROT_BINOPS, where float
+	 * op int yields an int except for the division */
+	if (left == DT_STR) return DT_STR;
+	if (left == DT_INT && right == DT_INT) return DT_INT;
+	if (left == DT_FLOAT && right == DT_INT) return op == OPR_DIV ? DT_FLOAT : DT_INT;
+	return DT_FLOAT;
+}
+
+static data_type_t typecheck_unop(Node *node, data_type_t right) {
+	if (right == DT_UNKNOWN) return node->op == OPR_NOT ? DT_BOOL : DT_UNKNOWN;
+
+	if ((node->op == OPR_NOT && right != DT_BOOL) ||
+	    (node->op == OPR_NEGATE && right != DT_INT && right != DT_FLOAT)) {
+		typecheck_error(node, "Cannot perform unary %s on %s",
+		                operator_to_str(node->op), data_type_to_str(right));
+	}
+	return right;
+}
+
+static data_type_t typecheck_func_call(TypeChecker *checker, Node *node) {
+	StaticVar callee = static_var(DT_UNKNOWN);
+	if (node->callee->type == N_VAR_ACCESS) {
+		StaticVar *var = typecheck_lookup(checker, node->callee);
+		if (var != NULL) callee = *var;
+		node->callee->static_type = callee.type;
+	} else {
+		callee.type = typecheck_visit(checker, node->callee);
+	}
+	if (callee.type != DT_UNKNOWN && callee.type != DT_FUNC)
+		typecheck_error(node, "%s is not callable", data_type_to_str(callee.type));
+
+	Node *func_def = callee.func_def;
+	if (func_def != NULL && func_def->func_params.len != node->func_args.len) {
+		typecheck_error(node, "Function '%s' accepts %d arguments, but %d are passed.",
+		                func_def->func_name, func_def->func_params.len,
+		                node->func_args.len);
+	}
+	for (int i = 0; i < node->func_args.len; i++) {
+		data_type_t arg_type = typecheck_visit(checker, node->func_args.items[i]);
+		if (func_def == NULL || arg_type == DT_UNKNOWN) continue;
+
+		Node *param = func_def->func_params.items[i];
+		if (param->var_decl_type != DT_UNKNOWN && param->var_decl_type != arg_type) {
+			typecheck_error(node, "Function '%s' expects %s for parameter '%s', but %s is passed.",
+			                func_def->func_name, param->var_type_str,
+			                param->var_name, data_type_to_str(arg_type));
+		}
+	}
+	return callee.ret_type;
+}
+
+/*===========================================================================
+ * Statements
+ *===========================================================================*/
+static void typecheck_declared_type(Node *node, char *type_str, data_type_t type) {
+	if (type == DT_UNKNOWN)
+		typecheck_error(node, "unknown type '%s'", type_str);
+}
+
+static data_type_t typecheck_var_def(TypeChecker *checker, Node *node) {
+	typecheck_declared_type(node, node->var_type_str, node->var_decl_type);
+	data_type_t type = typecheck_visit(checker, node->var_node);
+	if (type != DT_UNKNOWN && type != node->var_decl_type) {
+		typecheck_error(node, "variable '%s' is declared as %s, but is given %s",
+		                node->var_name, node->var_type_str,
+		                data_type_to_str(type));
+	}
+	typecheck_bind(checker, node->var_name, static_var(type));
+	return type;
+}
+
+static data_type_t typecheck_func_def(TypeChecker *checker, Node *node) {
+	/* The parameters are checked against their declared types at each
+	 * call, so the body can rely on them */
+	typecheck_declared_type(node, node->func_ret_type_str, node->func_ret_type);
+	TypeEnv *env = NULL;
+	for (int i = 0; i < node->func_params.len; i++) {
+		Node *param = node->func_params.items[i];
+		typecheck_declared_type(param, param->var_type_str, param->var_decl_type);
+		hmput(env, param->var_name, static_var(param->var_decl_type));
+	}
+
+	int function_base = checker->function_base;
+	arrput(checker->scopes, env);
+	checker->function_base = arrlen(checker->scopes) - 1;
+
+	/* The first return at the top of the body ends every call */
+	data_type_t ret_type = DT_NULL;
+	Node *ret_node = NULL;
+	for (int i = 0; i < node->func_statements.len; i++) {
+		Node *stmt = node->func_statements.items[i];
+		data_type_t type = typecheck_visit(checker, stmt);
+		if (stmt->type == N_RETURN && ret_node == NULL) {
+			ret_type = type;
+			ret_node = stmt;
+		}
+	}
+	env = arrpop(checker->scopes);
+	hmfree(env);
+	checker->function_base = function_base;
+
+	if (ret_type != DT_UNKNOWN && ret_type != node->func_ret_type) {
+		if (ret_node == NULL)
+			typecheck_error(node, "function '%s' must return %s",
+			                node->func_name, node->func_ret_type_str);
+		typecheck_error(ret_node, "function '%s' is declared to return %s, but returns %s",
+		                node->func_name, node->func_ret_type_str,
+		                data_type_to_str(ret_type));
+	}
+
+	StaticVar function = {DT_FUNC, ret_type, node};
+	typecheck_bind(checker, node->func_name, function);
+	return DT_NULL;
+}
+
+static data_type_t typecheck_if(TypeChecker *checker, Node *node) {
+	/* Every branch starts from the bindings made by its conditions, the
+	 * code after the if statement only keeps what all of them agree on */
+	TypeEnv **branches = NULL;
+	for (int i = 0; i < node->conditions.len; i++) {
+		typecheck_visit(checker, node->conditions.items[i]);
+		TypeEnv *next = type_env_copy(*typecheck_current(checker));
+		typecheck_visit(checker, node->if_blocks.items[i]);
+		arrput(branches, *typecheck_current(checker));
+		*typecheck_current(checker) = next;
+	}
+	if (node->else_block != NULL) typecheck_visit(checker, node->else_block);
+	arrput(branches, *typecheck_current(checker));
+
+	*typecheck_current(checker) = type_env_merge(branches);
+	for (int i = 0; i < arrlen(branches); i++) {
+		hmfree(branches[i]);
+	}
+	arrfree(branches);
+	return DT_NULL;
+}
+
+static data_type_t typecheck_iter(TypeChecker *checker, Node *node) {
+	data_type_t type = typecheck_visit(checker, node->iterable);
+	if (type != DT_UNKNOWN && type != DT_LIST)
+		typecheck_error(node, "%s is not iterable", data_type_to_str(type));
+
+	/* The scope of a loop persists across iterations, so only what is
+	 * bound before a read in the same iteration is known */
+	TypeEnv *env = NULL;
+	if (node->loop_with_index)
+		hmput(env, node->loop_index_var_name, static_var(DT_INT));
+	arrput(checker->scopes, env);
+	for (int i = 0; i < node->loop_statements.len; i++) {
+		typecheck_visit(checker, node->loop_statements.items[i]);
+	}
+	env = arrpop(checker->scopes);
+	hmfree(env);
+	return DT_NULL;
+}
+
+static data_type_t typecheck_visit(TypeChecker *checker, Node *node) {
+	data_type_t type = DT_UNKNOWN;
+	switch (node->type) {
+		case N_LITERAL:
+			if (node->var_type == DT_LIST) {
+				for (int i = 0; i < node->list_items.len; i++) {
+					typecheck_visit(checker, node->list_items.items[i]);
+				}
+			}
+			type = node->var_type;
+			break;
+		case N_BINOP: {
+			data_type_t left = typecheck_visit(checker, node->left);
+			data_type_t right = typecheck_visit(checker, node->right);
+			type = typecheck_binop(node, left, right);
+			break;
+		}
+		case N_UNOP:
+			type = typecheck_unop(node, typecheck_visit(checker, node->right));
+			break;
+		case N_VAR_ACCESS: {
+			StaticVar *var = typecheck_lookup(checker, node);
+			if (var != NULL) type = var->type;
+			break;
+		}
+		case N_VAR_ASSIGN: {
+			type = typecheck_visit(checker, node->var_node);
+			StaticVar var = static_var(type);
+			/* keep what is known about an assigned function */
+			if (node->var_node->type == N_VAR_ACCESS) {
+				StaticVar *value = typecheck_lookup(checker, node->var_node);
+				if (value != NULL) var = *value;
+			}
+			typecheck_bind(checker, node->var_name, var);
+			break;
+		}
+		case N_VAR_DEF:
+			type = typecheck_var_def(checker, node);
+			break;
+		case N_FUNC_DEF:
+			type = typecheck_func_def(checker, node);
+			break;
+		case N_FUNC_CALL:
+			type = typecheck_func_call(checker, node);
+			break;
+		case N_GET_ITEM: {
+			data_type_t list_type = typecheck_visit(checker, node->list_node);
+			data_type_t index_type = typecheck_visit(checker, node->index_node);
+			if (list_type != DT_UNKNOWN && list_type != DT_LIST)
+				typecheck_error(node, "%s is not subscriptable",
+				                data_type_to_str(list_type));
+			if (index_type != DT_UNKNOWN && index_type != DT_INT)
+				typecheck_error(node, "list indices must be int, not %s",
+				                data_type_to_str(index_type));
+			break;
+		}
+		case N_IF:
+			type = typecheck_if(checker, node);
+			break;
+		case N_ITER:
+			type = typecheck_iter(checker, node);
+			break;
+		case N_RETURN:
+			type = typecheck_visit(checker, node->return_value);
+			break;
+		case N_BLOCK:
+			for (int i = 0; i < node->block_statements.len; i++) {
+				typecheck_visit(checker, node->block_statements.items[i]);
+			}
+			type = DT_NULL;
+			break;
+		default:
+			break;
+	}
+	node->static_type = type;
+	return type;
+}
+
+/*===========================================================================
+ * Type checking
+ *===========================================================================*/
+void carrot_typecheck(Node *script, Interpreter *globals) {
+	TypeChecker checker;
+	checker.scopes = NULL;
+	checker.function_base = 0;
+
+	/* The globals bound before execution are the builtins */
+	TypeEnv *env = NULL;
+	for (int i = 0; i < hmlen(globals->layout->slots); i++) {
+		CarrotValue value = globals->slots[globals->layout->slots[i].value];
+		if (value.type != CARROT_FUNCTION) continue;
+
+		StaticVar builtin = {DT_FUNC, carrot_builtin_ret_type(value.obj), NULL};
+		hmput(env, globals->layout->slots[i].key, builtin);
+	}
+	arrput(checker.scopes, env);
+
+	for (int i = 0; i < script->statements.len; i++) {
+		typecheck_visit(&checker, script->statements.items[i]);
+	}
+	hmfree(checker.scopes[0]);
+	arrfree(checker.scopes);
+}
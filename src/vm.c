@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/builtin_func.h"
+#include "../include/gc.h"
+#include "../include/logutils.h"
+#include "../include/profiler.h"
+#include "../include/vm.h"
+#include "../lib/include/stb_ds.h"
+
+#define READ_BYTE()  (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t) ((ip[-2] << 8) | ip[-1]))
+#define PUSH(obj)    (*vm->sp++ = (obj))
+#define POP()        (*--vm->sp)
+#define PEEK(n)      (vm->sp[-1 - (n)])
+
+static void vm_push_scope(VM *vm, CallFrame *frame, ScopeLayout *layout) {
+	int slot_cnt = scope_layout_size(layout);
+	if (vm->scope_cnt == VM_SCOPES_MAX ||
+	    vm->slots_top + slot_cnt > vm->slots + VM_SLOTS_MAX) {
+		printf("ERROR: Stack overflow, too many nested scopes\n");
+		exit(1);
+	}
+	Interpreter *scope = &vm->scopes[vm->scope_cnt++];
+	interpreter_open_scope(scope, frame->scope, layout, vm->slots_top);
+	vm->slots_top += slot_cnt;
+	frame->scope = scope;
+}
+
+static void vm_pop_scope(VM *vm) {
+	Interpreter *scope = &vm->scopes[--vm->scope_cnt];
+	vm->slots_top = scope->slots;
+	interpreter_free(scope);
+}
+
+static VMIter *vm_push_iter(VM *vm) {
+	if (vm->iter_cnt == VM_ITERS_MAX) {
+		printf("ERROR: Too many nested iter loops\n");
+		exit(1);
+	}
+	VMIter *iter = &vm->iters[vm->iter_cnt++];
+	iter->counted = 0;
+	return iter;
+}
+
+static void vm_count_iter(VMIter *iter, int start, int stop, int step) {
+	/* The items of a counted loop are computed from cur and step, the
+	 * iterator only counts them */
+	iter->iter.idx = 0;
+	iter->counted = 1;
+	iter->cur = start;
+	iter->step = step;
+	iter->remaining = carrot_range_count(start, stop, step);
+}
+
+static void vm_mark_roots(void *data) {
+	VM *vm = data;
+	for (CarrotValue *slot = vm->stack; slot < vm->sp; slot++) {
+		carrot_gc_mark_value(*slot);
+	}
+	for (int i = 0; i < vm->scope_cnt; i++) {
+		carrot_gc_mark_scope(&vm->scopes[i]);
+	}
+	for (int i = 0; i < vm->frame_cnt; i++) {
+		Chunk *chunk = vm->frames[i].chunk;
+		for (int j = 0; j < arrlen(chunk->constants); j++) {
+			carrot_gc_mark_value(chunk->constants[j]);
+		}
+	}
+}
+
+static int vm_profile_walk(void *data, ProfileFrame *frames, int max) {
+	/* Runs in the signal handler of the profiler. The ip of a frame is
+	 * past the last call or loop iteration it made. */
+	VM *vm = data;
+	int depth = 0;
+	for (int i = 0; i < vm->frame_cnt && depth < max; i++, depth++) {
+		Chunk *chunk = vm->frames[i].chunk;
+		long offset = vm->frames[i].ip - chunk->code - 1;
+		frames[depth].name = chunk->name;
+		frames[depth].line = offset >= 0 ? chunk->lines[offset] : 0;
+	}
+	if (vm->builtin_name != NULL && depth < max) {
+		frames[depth].name = vm->builtin_name;
+		frames[depth].line = 0;
+		depth++;
+	}
+	return depth;
+}
+
+static CallFrame *vm_call(VM *vm, CallFrame *frame, int argc) {
+	CarrotValue callee_value = PEEK(argc);
+	if (callee_value.type != CARROT_FUNCTION) {
+		printf("ERROR: %s is not callable\n", carrot_type_str(callee_value));
+		exit(1);
+	}
+	CarrotObj *callee = callee_value.obj;
+
+	if (callee->builtin_func != NULL) {
+		arrsetlen(vm->builtin_args, 0);
+		for (int i = argc - 1; i >= 0; i--) {
+			arrput(vm->builtin_args, PEEK(i));
+		}
+		vm->builtin_name = callee->func_name;
+		CarrotValue res = callee->builtin_func(vm->builtin_args);
+		vm->builtin_name = NULL;
+		for (int i = 0; i <= argc; i++) {
+			carrot_decref(POP());
+		}
+		PUSH(res);
+		return frame;
+	}
+
+	Node *func_def = callee->func_def;
+	if (argc != func_def->func_params.len) {
+		printf("ERROR: Function '%s' accepts %d arguments, but %d are passed.\n",
+		       callee->func_name, func_def->func_params.len, argc);
+		exit(1);
+	}
+	if (vm->frame_cnt == VM_FRAMES_MAX ||
+	    vm->sp - vm->stack > VM_STACK_MAX - 256) {
+		printf("ERROR: Stack overflow in function '%s'\n", callee->func_name);
+		exit(1);
+	}
+
+	/* Functions see the scope of their caller, the same way
+	 * interpreter_visit_func_call chains the local interpreter. The
+	 * profiler may sample the frames at any time, a frame is counted
+	 * once its chunk and ip are set. */
+	CallFrame *callee_frame = &vm->frames[vm->frame_cnt];
+	callee_frame->chunk = callee->func_chunk;
+	callee_frame->ip = callee->func_chunk->code;
+	atomic_signal_fence(memory_order_release);
+	vm->frame_cnt++;
+	callee_frame->scope = frame->scope;
+	callee_frame->stack_base = vm->sp - argc - 1;
+	callee_frame->scope_base = vm->scope_cnt;
+	callee_frame->iter_base = vm->iter_cnt;
+
+	/* parameters occupy the first slots, the arguments are moved there
+	 * from the stack. The callee stays on the stack until the return. */
+	vm_push_scope(vm, callee_frame, func_def->scope_layout);
+	for (int i = 0; i < argc; i++) {
+		carrot_check_arg(callee, i, callee_frame->stack_base[i + 1]);
+		callee_frame->scope->slots[i] = callee_frame->stack_base[i + 1];
+		callee_frame->stack_base[i + 1] = carrot_null();
+	}
+	return callee_frame;
+}
+
+static CarrotValue vm_run(VM *vm) {
+	CallFrame *frame = &vm->frames[vm->frame_cnt - 1];
+	/* The instruction pointer of the current frame is kept in a local
+	 * and stored back into the frame only around calls and returns, and
+	 * at the end of each loop iteration. Each stack entry owns a
+	 * reference to its value. */
+	uint8_t *ip = frame->ip;
+
+	for (;;) {
+		uint8_t instruction = READ_BYTE();
+		switch (instruction) {
+			case OP_CONST:
+				PUSH(carrot_incref(frame->chunk->constants[READ_SHORT()]));
+				break;
+			case OP_POP:
+				carrot_decref(POP());
+				break;
+			case OP_GET_LOCAL: {
+				int depth = READ_BYTE();
+				Interpreter *scope = frame->scope;
+				while (depth-- > 0) scope = scope->parent;
+				CarrotValue value = scope->slots[READ_SHORT()];
+				char *var_name = frame->chunk->names[READ_SHORT()];
+				/* the slot is not bound yet, fall back to the names */
+				if (value.type == CARROT_UNDEFINED)
+					value = carrot_lookup_var(var_name, frame->scope);
+				PUSH(carrot_incref(value));
+				break;
+			}
+			case OP_GET_GLOBAL: {
+				CarrotValue value = vm->globals->slots[READ_SHORT()];
+				char *var_name = frame->chunk->names[READ_SHORT()];
+				if (value.type == CARROT_UNDEFINED)
+					value = carrot_lookup_var(var_name, frame->scope);
+				PUSH(carrot_incref(value));
+				break;
+			}
+			case OP_GET_VAR: {
+				char *var_name = frame->chunk->names[READ_SHORT()];
+				PUSH(carrot_incref(carrot_lookup_var(var_name, frame->scope)));
+				break;
+			}
+			case OP_SET_LOCAL:
+				carrot_assign(&frame->scope->slots[READ_SHORT()],
+				              carrot_incref(PEEK(0)));
+				break;
+			case OP_DEF_LOCAL: {
+				CarrotValue *slot = &frame->scope->slots[READ_SHORT()];
+				char *var_name = frame->chunk->names[READ_SHORT()];
+				if (slot->type != CARROT_UNDEFINED) {
+					printf("ERROR: variable redefinition in the same scope: %s\n",
+					       var_name);
+					exit(1);
+				}
+				*slot = POP();
+				break;
+			}
+			case OP_DEF_FUNC: {
+				CarrotValue function = frame->chunk->constants[READ_SHORT()];
+				carrot_assign(&frame->scope->slots[READ_SHORT()],
+				              carrot_incref(function));
+				break;
+			}
+			case OP_BINARY: {
+				operator_t op = READ_BYTE();
+				CarrotValue right = POP();
+				CarrotValue left = vm->sp[-1];
+				vm->sp[-1] = carrot_binop(op, left, right);
+				carrot_decref(left);
+				carrot_decref(right);
+				break;
+			}
+			case OP_BINARY_INT: {
+				operator_t op = READ_BYTE();
+				int right = POP().int_val;
+				vm->sp[-1] = carrot_int_binop(op, vm->sp[-1].int_val, right);
+				break;
+			}
+			case OP_BINARY_FLOAT: {
+				operator_t op = READ_BYTE();
+				float right = POP().float_val;
+				vm->sp[-1] = carrot_float_binop(op, vm->sp[-1].float_val, right);
+				break;
+			}
+			case OP_NOT:
+				vm->sp[-1] = carrot_unop(OPR_NOT, vm->sp[-1]);
+				break;
+			case OP_NEGATE:
+				vm->sp[-1] = carrot_unop(OPR_NEGATE, vm->sp[-1]);
+				break;
+			case OP_BUILD_LIST: {
+				int item_cnt = READ_SHORT();
+				CarrotValue *list_items = NULL;
+				for (int i = item_cnt - 1; i >= 0; i--) {
+					arrput(list_items, PEEK(i));
+				}
+				vm->sp -= item_cnt;
+				PUSH(carrot_list(list_items));
+				break;
+			}
+			case OP_GET_ITEM: {
+				CarrotValue the_index = POP();
+				CarrotValue the_list = POP();
+				PUSH(carrot_incref(carrot_get_item(the_list, the_index)));
+				carrot_decref(the_list);
+				carrot_decref(the_index);
+				break;
+			}
+			case OP_JUMP: {
+				uint16_t offset = READ_SHORT();
+				ip += offset;
+				break;
+			}
+			case OP_JUMP_IF_FALSE: {
+				uint16_t offset = READ_SHORT();
+				CarrotValue condition = POP();
+				if (!carrot_is_true(condition)) ip += offset;
+				carrot_decref(condition);
+				break;
+			}
+			case OP_CALL:
+				carrot_gc_safepoint();
+				frame->ip = ip + 1;
+				frame = vm_call(vm, frame, ip[0]);
+				ip = frame->ip;
+				break;
+			case OP_RETURN: {
+				CarrotValue result = POP();
+				while (vm->scope_cnt > frame->scope_base) {
+					vm_pop_scope(vm);
+				}
+				vm->iter_cnt = frame->iter_base;
+				/* the callee and the iterables of the loops left */
+				while (vm->sp > frame->stack_base) {
+					carrot_decref(POP());
+				}
+				vm->frame_cnt--;
+				if (vm->frame_cnt == 0) return result;
+
+				PUSH(result);
+				frame = &vm->frames[vm->frame_cnt - 1];
+				ip = frame->ip;
+				break;
+			}
+			case OP_ITER_BEGIN: {
+				ScopeLayout *layout = frame->chunk->layouts[READ_SHORT()];
+				/* the iterable stays on the stack until OP_ITER_END
+				 * so that it remains reachable for the collector */
+				CarrotValue iterable = PEEK(0);
+				VMIter *iter = vm_push_iter(vm);
+				carrot_iter_init(&iter->iter, iterable);
+				if (iterable.type == CARROT_RANGE) {
+					CarrotObj *range = iterable.obj;
+					vm_count_iter(iter, range->range_start,
+					              range->range_stop, range->range_step);
+				}
+				vm_push_scope(vm, frame, layout);
+				break;
+			}
+			case OP_ITER_RANGE: {
+				int argc = READ_BYTE();
+				ScopeLayout *layout = frame->chunk->layouts[READ_SHORT()];
+				uint16_t offset = READ_SHORT();
+				/* anything else than the builtin is called as usual */
+				if (!carrot_is_range_func(PEEK(argc))) break;
+
+				int start, stop, step;
+				carrot_range_args(vm->sp - argc, argc, &start, &stop, &step);
+				vm->sp -= argc;         // ints, nothing to release
+				carrot_decref(POP());
+				PUSH(carrot_null());    // popped by OP_ITER_END
+				vm_count_iter(vm_push_iter(vm), start, stop, step);
+				vm_push_scope(vm, frame, layout);
+				ip += offset;
+				break;
+			}
+			case OP_ITER_NEXT: {
+				uint16_t slot = READ_SHORT();
+				uint16_t index_slot = READ_SHORT();
+				uint16_t loop_offset = READ_SHORT();
+				VMIter *iter = &vm->iters[vm->iter_cnt - 1];
+				CarrotValue *slots = frame->scope->slots;
+				if (iter->counted) {
+					/* the item is written in place, going through a
+					 * local would stall on the store forwarding */
+					if (iter->remaining == 0) break;
+					carrot_decref(slots[slot]);
+					slots[slot] = (CarrotValue) {CARROT_INT, {.int_val = iter->cur}};
+					iter->remaining--;
+					/* stepping past the last item could overflow */
+					if (iter->remaining > 0) iter->cur += iter->step;
+					iter->iter.idx++;
+				} else {
+					/* the item is borrowed from the iterable */
+					CarrotValue item;
+					if (!carrot_iter_next(&iter->iter, &item)) break;
+					carrot_assign(&slots[slot], carrot_incref(item));
+				}
+				if (index_slot != CHUNK_NO_SLOT)
+					carrot_assign(&slots[index_slot],
+					              (CarrotValue) {CARROT_INT, {.int_val = iter->iter.idx - 1}});
+				frame->ip = ip;   // the profiler reports the loop line
+				ip -= loop_offset;
+				carrot_gc_safepoint();
+				break;
+			}
+			case OP_ITER_END:
+				vm->iter_cnt--;
+				carrot_decref(POP());
+				frame->scope = frame->scope->parent;
+				vm_pop_scope(vm);
+				break;
+			default:
+				printf("ERROR: Unknown opcode %d\n", instruction);
+				exit(1);
+		}
+	}
+}
+
+/*===========================================================================
+ * Bytecode execution
+ *===========================================================================*/
+CarrotValue vm_interpret(Interpreter *globals, Chunk *chunk) {
+	VM *vm = calloc(1, sizeof(VM));
+	vm->sp = vm->stack;
+	vm->slots_top = vm->slots;
+	vm->globals = globals;
+	vm->builtin_args = NULL;
+
+	CallFrame *frame = &vm->frames[vm->frame_cnt++];
+	frame->chunk = chunk;
+	frame->ip = chunk->code;
+	frame->scope = globals;
+	frame->stack_base = vm->stack;
+	frame->scope_base = 0;
+	frame->iter_base = 0;
+
+	carrot_gc_add_marker(vm_mark_roots, vm);
+	carrot_profile_set_walker(vm_profile_walk, vm);
+	CarrotValue result = vm_run(vm);
+	carrot_profile_set_walker(NULL, NULL);
+	carrot_gc_remove_marker(vm_mark_roots, vm);
+
+	arrfree(vm->builtin_args);
+	free(vm);
+	return result;
+}
@@ -5,20 +5,24 @@ from termcolor import colored
 
 test_files = sorted(glob("*.cr"))
 expected_files = sorted(glob("*.expected"))
+engines = ["ast", "vm"]
 
 
 assert len(test_files) == len(expected_files), "Ensure the *.expected file exists for each *.cr test file"
-test_cnt = len(test_files)
+test_cnt = len(test_files) * len(engines)
 
 def simple_test():
     len_longest = len(max(test_files, key=len))
     results = []
-    for i, (test_file, expected_file) in enumerate(zip(test_files, expected_files)):
+    cases = [(engine, test_file, expected_file)
+             for engine in engines
+             for test_file, expected_file in zip(test_files, expected_files)]
+    for i, (engine, test_file, expected_file) in enumerate(cases):
         with open(expected_file) as f:
             expected = f.read().strip()
 
         try:
-            test = subprocess.check_output(f"../carrot.out {test_file}", shell=True)
+            test = subprocess.check_output(f"../carrot.out --engine={engine} {test_file}", shell=True)
             test = test.decode(sys.stdout.encoding).strip()
 
             if test == expected:
@@ -30,6 +34,7 @@ def simple_test():
 
         result = {
             "filename": test_file,
+            "engine": engine,
             "status": status
         }
         results.append(result)
@@ -43,7 +48,7 @@ def simple_test():
 
         len_test_file = len(test_file)
         n_spaces = len_longest - len_test_file + 10
-        print(f"{test_file} {'.' * n_spaces} ({i+1}/{test_cnt}): {status}")
+        print(f"[{engine}] {test_file} {'.' * n_spaces} ({i+1}/{test_cnt}): {status}")
     return results
 
 if __name__ == "__main__":